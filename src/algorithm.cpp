@@ -25,14 +25,28 @@
  */
 
 #include "algorithm.h"
+#include "trace.h"
 
 #include <dlib/opencv.h>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/imgproc.hpp>
+#include <stdexcept>
 
 // down sample ratio
 #define DSRATIO 4
 
+// default motion gate threshold, mean absolute difference per channel
+#define MOTION_THRESHOLD 2.0
+
+// force a full detection after this many gated frames
+#define MOTION_MAX_SKIP 30
+
+// margin added around the face region for the motion gate, fraction of face size
+#define MOTION_MARGIN 0.25
+
+// margin decoded around the face for landmarking when no preview is needed, fraction of face size
+#define LANDMARK_MARGIN 0.5
+
 class Detection {
 public:
   Detection(dlib::full_object_detection *rawDet) : _rawDet(rawDet) {}
@@ -43,6 +57,68 @@ private:
   dlib::full_object_detection *_rawDet;
 };
 
+// landmark layout of a shape predictor model with Parts parts
+// index lists the parts used for pose solving, reference their position on a generic 3D face
+template <size_t Parts> struct Landmarks;
+
+// 68 point iBUG 300-W model
+template <> struct Landmarks<68> {
+  static const size_t count = 6;
+  static const size_t index[count];
+  static const double reference[count][3];
+  // the DLT initial guess of SOLVEPNP_ITERATIVE needs 6 non-planar points
+  static const int method = cv::SOLVEPNP_ITERATIVE;
+};
+
+const size_t Landmarks<68>::index[] = {
+    30, // nose tip
+    8,  // chin
+    36, // left eye left corner
+    45, // right eye right corner
+    48, // left Mouth corner
+    54, // right mouth corner
+};
+
+// The first must be (0,0,0) while using POSIT
+const double Landmarks<68>::reference[][3] = {
+    {0.0, 0.0, 0.0}, {0.0, -330.0, -65.0}, {-225.0, 170.0, -135.0}, {225.0, 170.0, -135.0}, {-150.0, -150.0, -125.0}, {150.0, -150.0, -125.0},
+};
+
+// 5 point dlib model, eye corners and bottom of the nose
+template <> struct Landmarks<5> {
+  static const size_t count = 5;
+  static const size_t index[count];
+  static const double reference[count][3];
+  static const int method = cv::SOLVEPNP_EPNP;
+};
+
+const size_t Landmarks<5>::index[] = {
+    4, // bottom of nose
+    2, // left eye left corner
+    0, // right eye right corner
+    3, // left eye right corner
+    1, // right eye left corner
+};
+
+const double Landmarks<5>::reference[][3] = {
+    {0.0, -45.0, -70.0}, {-225.0, 170.0, -135.0}, {225.0, 170.0, -135.0}, {-80.0, 170.0, -95.0}, {80.0, 170.0, -95.0},
+};
+
+template <size_t Parts> void _collectCameraPoints(dlib::full_object_detection &rawDet, std::vector<cv::Point2d> &cp) {
+  // wrap dlib::full_object_detection
+  Detection det(&rawDet);
+  cp.clear();
+  for (size_t i = 0; i < Landmarks<Parts>::count; i++)
+    cp.push_back(det[Landmarks<Parts>::index[i]]);
+}
+
+template <size_t Parts> void _loadReferencePoints(std::vector<cv::Point3d> &referencePoints, int &method) {
+  referencePoints.clear();
+  for (size_t i = 0; i < Landmarks<Parts>::count; i++)
+    referencePoints.emplace_back(Landmarks<Parts>::reference[i][0], Landmarks<Parts>::reference[i][1], Landmarks<Parts>::reference[i][2]);
+  method = Landmarks<Parts>::method;
+}
+
 bool _cameraPointsConsideredSame(std::vector<cv::Point2d> &last, std::vector<cv::Point2d> &current) {
   if (last.empty() || (last.size() != current.size()))
     return false;
@@ -56,97 +132,252 @@ bool _cameraPointsConsideredSame(std::vector<cv::Point2d> &last, std::vector<cv:
   return (total / base) < 0.1;
 }
 
-bool _compareRectangleArea(dlib::rectangle &lhs, dlib::rectangle &rhs) { return lhs.area() < rhs.area(); }
+bool _compareRectArea(const cv::Rect &lhs, const cv::Rect &rhs) { return lhs.area() < rhs.area(); }
 
-altego::Algorithm::Algorithm() {
+altego::Algorithm::Algorithm() : _motionThreshold(MOTION_THRESHOLD), _gateInvalidated(false) {
   // initialize detector
-  _detector = dlib::get_frontal_face_detector();
-
-  // initialize reference points
-  // The first must be (0,0,0) while using POSIT
-  _referencePoints.emplace_back(0.0f, 0.0f, 0.0f);          // 30
-  _referencePoints.emplace_back(0.0f, -330.0f, -65.0f);     // 8
-  _referencePoints.emplace_back(-225.0f, 170.0f, -135.0f);  // 36
-  _referencePoints.emplace_back(225.0f, 170.0f, -135.0f);   // 45
-  _referencePoints.emplace_back(-150.0f, -150.0f, -125.0f); // 48
-  _referencePoints.emplace_back(150.0f, -150.0f, -125.0f);  // 54
+  _detector.reset(new HogDetector());
 
   // initialize distCoeffs
   _distCoeffs = cv::Mat::zeros(4, 1, cv::DataType<double>::type);
+
+  // preallocate scratch buffers
+  _faces.reserve(16);
+  _frame.cameraPoints.reserve(Landmarks<68>::count);
+  _lastCameraPoints.reserve(Landmarks<68>::count);
+  _cameraMatrix.create(3, 3);
+  _rv.create(3, 1, cv::DataType<double>::type);
+  _tv.create(3, 1, cv::DataType<double>::type);
+  _lastParts.reserve(68);
+  _frame.parts.reserve(68);
+}
+
+void altego::Algorithm::SetMotionThreshold(double threshold) {
+  _motionThreshold = threshold;
+  _gateValid = false;
+}
+
+bool altego::Algorithm::faceRegionUnchanged() {
+  if (_motionThreshold <= 0 || !_gateValid)
+    return false;
+  // frame size changed
+  if (_gateFrameSize != _imSmall.size())
+    return false;
+  // refresh periodically so slow drift still reaches the landmarker
+  if (_gateSkipped >= MOTION_MAX_SKIP)
+    return false;
+  // L1 norm over the region is vectorized by OpenCV and needs no temporary
+  cv::Mat roi = _imSmall(_gateRect);
+  double diff = cv::norm(roi, _gateRef, cv::NORM_L1) / static_cast<double>(roi.total() * roi.channels());
+  return diff < _motionThreshold;
+}
+
+void altego::Algorithm::updateGate(const cv::Rect &faceSmall) {
+  // expand by margin and clip to frame
+  auto mx = static_cast<int>(faceSmall.width * MOTION_MARGIN);
+  auto my = static_cast<int>(faceSmall.height * MOTION_MARGIN);
+  cv::Rect rect(faceSmall.x - mx, faceSmall.y - my, faceSmall.width + 2 * mx, faceSmall.height + 2 * my);
+  rect &= cv::Rect(0, 0, _imSmall.cols, _imSmall.rows);
+  if (rect.area() == 0) {
+    _gateValid = false;
+    return;
+  }
+  _gateRect = rect;
+  _gateFrameSize = _imSmall.size();
+  // the reference is a view into a buffer of frame size, so a face region of another size does not reallocate
+  _gateBuffer.create(_imSmall.size(), _imSmall.type());
+  _gateRef = _gateBuffer(cv::Rect(0, 0, rect.width, rect.height));
+  _imSmall(_gateRect).copyTo(_gateRef);
+  _gateSkipped = 0;
+  _gateValid = true;
+}
+
+bool altego::Algorithm::decodeFrame(altego::Frame &frame) {
+  TraceSpan span("landmark.decode", static_cast<int64_t>(frame.index));
+  if (frame.preview)
+    return _jpegFull.Decode(frame.jpeg.data(), frame.jpeg.size(), 1, false, frame.im);
+  // nothing to landmark
+  if (!frame.found)
+    return true;
+  // the shape predictor samples around the face rectangle, pixels outside the region keep stale content
+  auto mx = static_cast<int>(frame.face.width() * LANDMARK_MARGIN);
+  auto my = static_cast<int>(frame.face.height() * LANDMARK_MARGIN);
+  cv::Rect roi(static_cast<int>(frame.face.left()) - mx, static_cast<int>(frame.face.top()) - my, static_cast<int>(frame.face.width()) + 2 * mx,
+               static_cast<int>(frame.face.height()) + 2 * my);
+  return _jpegFull.DecodeRegion(frame.jpeg.data(), frame.jpeg.size(), roi, frame.im);
 }
 
 bool altego::Algorithm::ResolveAndAnnotate(cv::Mat &im, altego::Result &res) {
-  // down sample for face detection
-  cv::Mat imSmall;
-  cv::resize(im, imSmall, cv::Size(), 1.0 / DSRATIO, 1.0 / DSRATIO);
-  // convert type with zero copy
-  dlib::cv_image<dlib::bgr_pixel> dim(im);
-  dlib::cv_image<dlib::bgr_pixel> dimSmall(imSmall);
-  // detect faces
-  auto faces = _detector(dimSmall);
-  if (faces.empty())
+  // share the caller's buffer, no copy
+  _frame.im = im;
+  Detect(_frame);
+  Landmark(_frame);
+  Solve(_frame);
+  _frame.im.release();
+  if (!_frame.resolved)
     return false;
+  res = _frame.result;
+  return true;
+}
+
+void altego::Algorithm::Detect(altego::Frame &frame) {
+  TraceSpan span("detect", static_cast<int64_t>(frame.index));
+  frame.gated = false;
+  frame.found = false;
+  frame.parts.clear();
+  frame.cameraPoints.clear();
+  frame.resolved = false;
+  // reference count only, no allocation
+  frame.model = std::atomic_load(&_model);
+
+  // down sample for face detection, reuses _imSmall unless frame size changed
+  if (!frame.jpeg.empty()) {
+    // scaled IDCT produces the small image directly, the full resolution image is never built here
+    TraceSpan decodeSpan("detect.decode", static_cast<int64_t>(frame.index));
+    if (!_jpegSmall.Decode(frame.jpeg.data(), frame.jpeg.size(), DSRATIO, true, _imSmall))
+      return;
+  } else {
+    cv::resize(frame.im, _imSmall, cv::Size(), 1.0 / DSRATIO, 1.0 / DSRATIO);
+  }
+  // skip detection and landmarking if the face region is static, the last result stays published
+  if (_gateInvalidated.exchange(false))
+    _gateValid = false;
+  if (faceRegionUnchanged()) {
+    _gateSkipped++;
+    frame.gated = true;
+    return;
+  }
+  _gateValid = false;
+  // detect faces
+  {
+    TraceSpan detectorSpan("detect.detector", static_cast<int64_t>(frame.index));
+    _detector->Detect(_imSmall, _faces);
+  }
+  if (_faces.empty())
+    return;
   // find largest face
-  auto face = *std::max_element(faces.begin(), faces.end(), _compareRectangleArea).base();
+  auto face = *std::max_element(_faces.begin(), _faces.end(), _compareRectArea);
+  // remember face region for the motion gate
+  updateGate(face);
   // upscale
-  face.left() *= DSRATIO;
-  face.top() *= DSRATIO;
-  face.right() *= DSRATIO;
-  face.bottom() *= DSRATIO;
-  // detection
-  auto rawDet = _predictor(dim, face);
+  frame.face = dlib::rectangle(face.x * DSRATIO, face.y * DSRATIO, (face.x + face.width - 1) * DSRATIO, (face.y + face.height - 1) * DSRATIO);
+  frame.found = true;
+}
+
+void altego::Algorithm::Landmark(altego::Frame &frame) {
+  TraceSpan span("landmark", static_cast<int64_t>(frame.index));
+  if (!frame.jpeg.empty() && !decodeFrame(frame)) {
+    _gateInvalidated = true;
+    return;
+  }
+  // redraw last landmarks for gated frames
+  if (frame.gated) {
+    frame.parts.assign(_lastParts.begin(), _lastParts.end());
+    // compressed frames without preview may not have been decoded at all
+    if (!_annotate || frame.im.empty())
+      return;
+    for (auto &p : _lastParts)
+      cv::circle(frame.im, p, 2, cv::Scalar(255, 0, 72), -1);
+    return;
+  }
+  if (!frame.found || !frame.model)
+    return;
+  const Model &model = *frame.model;
+  if (frame.model != _landmarkModel) {
+    _lastCameraPoints.clear();
+    _landmarkModel = frame.model;
+  }
+  // convert type with zero copy
+  dlib::cv_image<dlib::bgr_pixel> dim(frame.im);
+  // detection, dlib has no overload filling an existing full_object_detection, so this allocates per frame
+  auto rawDet = model.predictor(dim, frame.face);
   // check num_parts()
-  if (rawDet.num_parts() != 68)
-    return false;
+  if (rawDet.num_parts() != model.parts) {
+    _gateInvalidated = true;
+    return;
+  }
   // draw detection
+  _lastParts.clear();
   for (size_t i = 0; i < rawDet.num_parts(); i++) {
     dlib::point p = rawDet.part(i);
     // check part valid
-    if (p == dlib::OBJECT_PART_NOT_PRESENT)
-      return false;
-    cv::circle(im, cv::Point(static_cast<int>(p.x()), static_cast<int>(p.y())), 2, cv::Scalar(255, 0, 72), -1);
+    if (p == dlib::OBJECT_PART_NOT_PRESENT) {
+      _gateInvalidated = true;
+      return;
+    }
+    _lastParts.emplace_back(static_cast<int>(p.x()), static_cast<int>(p.y()));
+    if (_annotate)
+      cv::circle(frame.im, _lastParts.back(), 2, cv::Scalar(255, 0, 72), -1);
   }
+  frame.parts.assign(_lastParts.begin(), _lastParts.end());
 
-  // wrap dlib::full_object_detection
-  Detection det(&rawDet);
-
-  // cameraPoints
-  std::vector<cv::Point2d> cp;
-  // nose tip
-  cp.push_back(det[30]);
-  // chin
-  cp.push_back(det[8]);
-  // left eye left corner
-  cp.push_back(det[36]);
-  // right eye right corner
-  cp.push_back(det[45]);
-  // left Mouth corner
-  cp.push_back(det[48]);
-  // right mouth corner
-  cp.push_back(det[54]);
+  // cameraPoints, capacity retained across frames
+  std::vector<cv::Point2d> &cp = frame.cameraPoints;
+  if (model.parts == 5)
+    _collectCameraPoints<5>(rawDet, cp);
+  else
+    _collectCameraPoints<68>(rawDet, cp);
 
   // stabilize
-  if (_cameraPointsConsideredSame(_lastCameraPoints, cp))
-    return false;
+  if (_cameraPointsConsideredSame(_lastCameraPoints, cp)) {
+    cp.clear();
+    return;
+  }
 
   // update lastCameraPoints
-  _lastCameraPoints = cp;
+  _lastCameraPoints.assign(cp.begin(), cp.end());
+}
 
-  // camera matrix
-  cv::Mat_<double> cameraMatrix(3, 3);
-  cameraMatrix << im.cols, 0, im.cols / 2.f, 0, im.cols, im.rows / 2.f, 0, 0, 1;
+void altego::Algorithm::Solve(altego::Frame &frame) {
+  if (frame.cameraPoints.empty() || !frame.model)
+    return;
+  TraceSpan span("solve", static_cast<int64_t>(frame.index));
 
-  // rotation vector, translation vector
-  cv::Mat rv, tv;
+  // camera matrix, filled in place
+  _cameraMatrix(0, 0) = frame.im.cols;
+  _cameraMatrix(0, 1) = 0;
+  _cameraMatrix(0, 2) = frame.im.cols / 2.f;
+  _cameraMatrix(1, 0) = 0;
+  _cameraMatrix(1, 1) = frame.im.cols;
+  _cameraMatrix(1, 2) = frame.im.rows / 2.f;
+  _cameraMatrix(2, 0) = 0;
+  _cameraMatrix(2, 1) = 0;
+  _cameraMatrix(2, 2) = 1;
 
-  // solve
-  cv::solvePnP(_referencePoints, cp, cameraMatrix, _distCoeffs, rv, tv);
+  // solve, rotation vector and translation vector are written into the preallocated _rv, _tv
+  cv::solvePnP(frame.model->referencePoints, frame.cameraPoints, _cameraMatrix, _distCoeffs, _rv, _tv, false, frame.model->solveMethod);
 
   // set rv, tv to result
-  res.r1 = rv.at<double>(0, 1);
-  res.r2 = rv.at<double>(0, 2);
+  frame.result.r1 = _rv.at<double>(0, 1);
+  frame.result.r2 = _rv.at<double>(0, 2);
+  frame.result.timestamp = frame.timestamp;
+  frame.resolved = true;
+}
 
-  return true;
+void altego::Algorithm::SetAnnotate(bool annotate) { _annotate = annotate; }
+
+void altego::Algorithm::SetDetector(std::unique_ptr<altego::Detector> detector) {
+  _detector = std::move(detector);
+  _gateValid = false;
+}
+
+void altego::Algorithm::LoadModelFile(const std::string &modelFile) {
+  // built aside and published at once, the stages never see a half loaded model
+  std::shared_ptr<Model> model = std::make_shared<Model>();
+  dlib::deserialize(modelFile) >> model->predictor;
+  // pick the landmark layout matching the model
+  switch (model->predictor.num_parts()) {
+  case 68:
+    _loadReferencePoints<68>(model->referencePoints, model->solveMethod);
+    break;
+  case 5:
+    _loadReferencePoints<5>(model->referencePoints, model->solveMethod);
+    break;
+  default:
+    throw std::runtime_error("unsupported shape predictor with " + std::to_string(model->predictor.num_parts()) + " parts");
+  }
+  model->parts = model->predictor.num_parts();
+  std::atomic_store(&_model, std::shared_ptr<const Model>(model));
 }
 
-void altego::Algorithm::LoadModelFile(std::string &modelFile) { dlib::deserialize(modelFile) >> _predictor; }
+std::shared_ptr<const altego::Model> altego::Algorithm::GetModel() const { return std::atomic_load(&_model); }
@@ -27,25 +27,131 @@
 #ifndef __ALTEGO_ALGORITHM_H__
 #define __ALTEGO_ALGORITHM_H__
 
+#include "detector.h"
+#include "jpeg.h"
 #include "result.h"
 
+#include <atomic>
 #include <dlib/image_processing.h>
-#include <dlib/image_processing/frontal_face_detector.h>
+#include <memory>
 #include <opencv2/core.hpp>
 
 namespace altego {
+/**
+ * Model
+ *
+ * a loaded shape predictor with its landmark layout, never modified once published to the stages
+ */
+struct Model {
+  dlib::shape_predictor predictor;
+  // number of parts, 68 or 5
+  size_t parts = 68;
+  // generic 3D face positions of the parts used for pose solving
+  std::vector<cv::Point3d> referencePoints;
+  int solveMethod = 0;
+};
+
+/**
+ * Frame
+ *
+ * a camera frame travelling through the algorithm stages, reused across iterations
+ */
+class Frame {
+public:
+  // capture order, for tracing
+  uint64_t index = 0;
+  // capture time, wall clock nanoseconds since epoch
+  int64_t timestamp = 0;
+  // capture time, steady clock nanoseconds, for prediction
+  int64_t steady = 0;
+  // full resolution image, annotated in place
+  cv::Mat im;
+  // compressed frame from an MJPEG source, empty for decoded frames, capacity retained across frames
+  std::vector<uint8_t> jpeg;
+  // compressed frames only: decode the whole image for preview, otherwise only the face region is decoded
+  bool preview = true;
+  // model taken by Detect, so Landmark and Solve agree on the layout even if a new model is loaded meanwhile
+  std::shared_ptr<const Model> model;
+  // detection: skipped by motion gate
+  bool gated = false;
+  // detection: largest face in full resolution coordinates
+  bool found = false;
+  dlib::rectangle face;
+  // landmarking: landmark parts in full resolution coordinates, also set for gated frames
+  std::vector<cv::Point> parts;
+  // landmarking: camera points to solve, empty if there is nothing new to solve
+  std::vector<cv::Point2d> cameraPoints;
+  // solving: result is valid and should be published
+  bool resolved = false;
+  Result result;
+};
+
+/**
+ * Algorithm
+ *
+ * Detect, Landmark and Solve are the stages of ResolveAndAnnotate, they only touch their own
+ * state, so each of them may run on its own thread as long as frames pass through them in order
+ */
 class Algorithm {
 public:
   Algorithm();
   bool ResolveAndAnnotate(cv::Mat &im, Result &res);
-  void LoadModelFile(std::string &modelFile);
+  // downsample, motion gate and face detection
+  void Detect(Frame &frame);
+  // shape prediction, annotation and stabilization
+  void Landmark(Frame &frame);
+  // pose solving
+  void Solve(Frame &frame);
+  // load and publish a model, may be called while the stages run, frames in flight finish with the previous model
+  void LoadModelFile(const std::string &modelFile);
+  // the published model, nullptr before the first load
+  std::shared_ptr<const Model> GetModel() const;
+  // replace the face detector, call while no stage is running
+  void SetDetector(std::unique_ptr<Detector> detector);
+  // mean absolute pixel difference below which the face region is considered static, 0 disables the gate
+  void SetMotionThreshold(double threshold);
+  // whether landmarks are drawn into the frame, call while no stage is running
+  void SetAnnotate(bool annotate);
 
 private:
-  dlib::frontal_face_detector _detector;
-  dlib::shape_predictor _predictor;
-  std::vector<cv::Point3d> _referencePoints;
+  std::unique_ptr<Detector> _detector;
+  // replaced as a whole by LoadModelFile, accessed with std::atomic_load and std::atomic_store
+  std::shared_ptr<const Model> _model;
+  // model of the last landmarked frame, the stabilizer restarts when it changes
+  std::shared_ptr<const Model> _landmarkModel;
   std::vector<cv::Point2d> _lastCameraPoints;
   cv::Mat _distCoeffs;
+  bool _annotate = true;
+
+  // per-frame scratch buffers owned by altego, recycled across iterations, so after warm-up the stages allocate
+  // nothing of their own, which altego-alloccheck verifies for decoded frames
+  // it also measures the per-frame allocations accepted inside dependencies: the downsample, the detector's
+  // feature pyramid, the full_object_detection and feature vectors of the shape predictor and the temporaries of solvePnP,
+  // libjpeg's per-image pools for compressed frames are accepted as well but not measured
+  Frame _frame;
+  cv::Mat _imSmall;
+  std::vector<cv::Rect> _faces;
+  cv::Mat_<double> _cameraMatrix;
+  cv::Mat _rv, _tv;
+  // one decoder per stage, Detect and Landmark may run on different threads
+  JpegDecoder _jpegSmall, _jpegFull;
+
+  // motion gate, compares the face region of the downsampled frame against the last fully processed one
+  double _motionThreshold;
+  bool _gateValid = false;
+  // set by Landmark when landmarking failed, so Detect does not gate on a stale region
+  std::atomic<bool> _gateInvalidated;
+  int _gateSkipped = 0;
+  cv::Size _gateFrameSize;
+  cv::Rect _gateRect;
+  cv::Mat _gateBuffer, _gateRef;
+  std::vector<cv::Point> _lastParts;
+
+  bool faceRegionUnchanged();
+
+  void updateGate(const cv::Rect &faceSmall);
+
+  bool decodeFrame(Frame &frame);
 };
 } // namespace altego
 
@@ -0,0 +1,249 @@
+/**
+ * alloccheck.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "algorithm.h"
+#include "detector.h"
+
+#include <cstdio>
+#include <dlib/cmd_line_parser.h>
+#include <dlib/opencv.h>
+#include <iostream>
+#include <malloc.h>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace altego;
+
+// every allocation ends up in one of these, operator new and OpenCV's fastMalloc included, so they are counted here (glibc only)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+// counting is per thread, OpenCV is kept on the calling thread so nothing escapes it
+static thread_local bool _counting = false;
+static thread_local uint64_t _allocations = 0;
+
+static inline void _count() {
+  if (_counting)
+    _allocations++;
+}
+
+extern "C" {
+void *malloc(size_t size) {
+  _count();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  _count();
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  _count();
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  _count();
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  _count();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  _count();
+  void *p = __libc_memalign(alignment, size);
+  if (p == nullptr)
+    return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+}
+
+// allocations made by the calling thread while fn runs
+template <typename Fn> static uint64_t _countAllocations(Fn fn) {
+  uint64_t before = _allocations;
+  bool counting = _counting;
+  _counting = true;
+  fn();
+  _counting = counting;
+  return _allocations - before;
+}
+
+// passes through to a real detector and keeps what it allocated, so Detect can be charged only for its own allocations
+class CountingDetector : public Detector {
+public:
+  explicit CountingDetector(std::unique_ptr<Detector> detector) : _detector(std::move(detector)) {}
+
+  void Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) override { allocations = _countAllocations([&] { _detector->Detect(im, faces); }); }
+
+  uint64_t allocations = 0;
+
+private:
+  std::unique_ptr<Detector> _detector;
+};
+
+struct StageCount {
+  const char *name;
+  // frames that ran the stage, own allocations at most, dependency allocations in total and at most
+  uint64_t frames, ownMax, dependencyTotal, dependencyMax;
+  uint64_t failedFrame;
+
+  void Add(uint64_t frame, uint64_t all, uint64_t dependency) {
+    uint64_t own = all > dependency ? all - dependency : 0;
+    if (own > 0 && ownMax == 0)
+      failedFrame = frame;
+    frames++;
+    ownMax = std::max(ownMax, own);
+    dependencyTotal += dependency;
+    dependencyMax = std::max(dependencyMax, dependency);
+  }
+};
+
+// run the algorithm stages over recorded frames and check that, after warm-up, every allocation they make is made by a dependency
+// each dependency call is repeated on the same input outside the stage to measure its share
+int main(int argc, char **argv) {
+  dlib::command_line_parser parser;
+  parser.add_option("h", "Display this help message.");
+  parser.add_option("video", "Recorded frames to read, any file or pattern cv::VideoCapture accepts.", 1);
+  parser.add_option("model", "Shape predictor model file, 68 or 5 point.", 1);
+  parser.add_option("detector", "Face detector spec (default hog).", 1);
+  parser.add_option("frames", "Frames per cycle, read from the start of the video (default 30).", 1);
+  parser.add_option("cycles", "Measured cycles over the frames, after two warm-up cycles (default 3).", 1);
+  try {
+    parser.parse(argc, argv);
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (parser.option("h") || !parser.option("video") || !parser.option("model")) {
+    std::cout << "Usage: altego-alloccheck --video <file> --model <file> [options]" << std::endl;
+    parser.print_options();
+    return parser.option("h") ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  auto maxFrames = dlib::get_option(parser, "frames", 30);
+  auto cycles = dlib::get_option(parser, "cycles", 3);
+
+  cv::VideoCapture cap;
+  if (!cap.open(parser.option("video").argument())) {
+    std::cerr << "failed to open " << parser.option("video").argument() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<cv::Mat> frames;
+  cv::Mat im;
+  while (static_cast<int>(frames.size()) < maxFrames && cap.read(im))
+    frames.push_back(im.clone());
+  if (frames.empty()) {
+    std::cerr << "no frames read" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // parallel OpenCV calls would allocate on worker threads, out of sight of the counter
+  cv::setNumThreads(0);
+  Algorithm algorithm;
+  CountingDetector *detector = nullptr;
+  try {
+    algorithm.LoadModelFile(parser.option("model").argument());
+    detector = new CountingDetector(CreateDetector(dlib::get_option(parser, "detector", std::string("hog"))));
+    algorithm.SetDetector(std::unique_ptr<Detector>(detector));
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // buffers of the repeated dependency calls, sized during warm-up like the stage buffers
+  Frame frame;
+  cv::Mat small;
+  std::vector<cv::Point2d> cameraPoints;
+  cv::Mat_<double> cameraMatrix(3, 3);
+  cv::Mat distCoeffs = cv::Mat::zeros(4, 1, cv::DataType<double>::type);
+  cv::Mat rv(3, 1, cv::DataType<double>::type), tv(3, 1, cv::DataType<double>::type);
+
+  StageCount detect = {"detect", 0, 0, 0, 0, 0}, landmark = {"landmark", 0, 0, 0, 0, 0}, solve = {"solve", 0, 0, 0, 0, 0};
+  uint64_t index = 0;
+  for (int cycle = 0; cycle < 2 + cycles; cycle++) {
+    bool measured = cycle >= 2;
+    for (auto &source : frames) {
+      source.copyTo(frame.im);
+      frame.index = index++;
+
+      // detect: the downsample, by DSRATIO 4, and the detector are dependencies, the detector only runs on frames the motion gate lets through
+      detector->allocations = 0;
+      uint64_t all = _countAllocations([&] { algorithm.Detect(frame); });
+      uint64_t dependency = detector->allocations + _countAllocations([&] { cv::resize(frame.im, small, cv::Size(), 1.0 / 4, 1.0 / 4); });
+      if (measured)
+        detect.Add(frame.index, all, dependency);
+
+      // landmark: the shape predictor and the full_object_detection it returns are dependencies
+      bool predicted = !frame.gated && frame.found && frame.model;
+      all = _countAllocations([&] { algorithm.Landmark(frame); });
+      dependency = 0;
+      if (predicted) {
+        dlib::cv_image<dlib::bgr_pixel> dim(frame.im);
+        dependency = _countAllocations([&] { frame.model->predictor(dim, frame.face); });
+      }
+      if (measured && predicted)
+        landmark.Add(frame.index, all, dependency);
+
+      // solve: solvePnP and its temporaries are dependencies
+      bool solving = !frame.cameraPoints.empty();
+      cameraPoints.assign(frame.cameraPoints.begin(), frame.cameraPoints.end());
+      all = _countAllocations([&] { algorithm.Solve(frame); });
+      dependency = 0;
+      if (solving) {
+        cameraMatrix << frame.im.cols, 0, frame.im.cols / 2.f, 0, frame.im.cols, frame.im.rows / 2.f, 0, 0, 1;
+        dependency = _countAllocations([&] {
+          cv::solvePnP(frame.model->referencePoints, cameraPoints, cameraMatrix, distCoeffs, rv, tv, false, frame.model->solveMethod);
+        });
+      }
+      if (measured && solving)
+        solve.Add(frame.index, all, dependency);
+    }
+  }
+
+  printf("%zu frames x %d cycles\n", frames.size(), cycles);
+  printf("%-10s %10s %10s %16s %16s\n", "stage", "frames", "own max", "dependency mean", "dependency max");
+  bool failed = false;
+  for (auto stage : {detect, landmark, solve}) {
+    printf("%-10s %10llu %10llu %16.1f %16llu\n", stage.name, static_cast<unsigned long long>(stage.frames), static_cast<unsigned long long>(stage.ownMax),
+           stage.frames > 0 ? static_cast<double>(stage.dependencyTotal) / stage.frames : 0.0, static_cast<unsigned long long>(stage.dependencyMax));
+    if (stage.ownMax > 0) {
+      std::cerr << stage.name << ": allocates on its own after warm-up, first at frame " << stage.failedFrame << std::endl;
+      failed = true;
+    }
+    if (stage.frames == 0)
+      std::cerr << stage.name << ": never ran, use frames with a moving face" << std::endl;
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
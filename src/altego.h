@@ -0,0 +1,126 @@
+/**
+ * altego.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_H__
+#define __ALTEGO_H__
+
+/**
+ * C API of libaltego, for in-process consumers such as native Unity plugins
+ *
+ * all functions are thread safe unless noted, results are delivered without serialization
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define ALTEGO_EXPORT __declspec(dllexport)
+#else
+#define ALTEGO_EXPORT __attribute__((visibility("default")))
+#endif
+
+// bumped on any incompatible change of this header
+#define ALTEGO_API_VERSION 1
+
+typedef struct altego_pipeline altego_pipeline;
+
+typedef struct {
+  // sequence number, increases by one per published result
+  uint64_t seq;
+  // rotation vector
+  double r1;
+  double r2;
+} altego_result;
+
+// called on a pipeline thread for every published result, the capture thread or in staged mode the solve thread, must return quickly
+typedef void (*altego_result_callback)(const altego_result *result, void *user);
+
+// version of the library, compare against ALTEGO_API_VERSION
+ALTEGO_EXPORT int altego_api_version(void);
+
+// create a stopped pipeline, returns NULL on failure
+ALTEGO_EXPORT altego_pipeline *altego_create(void);
+
+// stop and free a pipeline
+ALTEGO_EXPORT void altego_destroy(altego_pipeline *pipeline);
+
+// message of the last failed call on this pipeline, valid until the next call
+ALTEGO_EXPORT const char *altego_last_error(altego_pipeline *pipeline);
+
+// load a 68 or 5 point shape predictor, returns 0 on success
+// the first load may follow altego_start, so the camera opens while the model loads,
+// a later load replaces the model while running, frames in flight finish with the previous one
+ALTEGO_EXPORT int altego_load_model(altego_pipeline *pipeline, const char *file);
+
+// select camera device and size, may be called while running
+ALTEGO_EXPORT void altego_set_device(altego_pipeline *pipeline, int device);
+ALTEGO_EXPORT void altego_set_size(altego_pipeline *pipeline, int width, int height);
+
+// select face detector: "hog" (default), "yunet:<model.onnx>", "cascade:<cascade.xml>" or "cascade+hog:<cascade.xml>"
+// call while stopped, returns 0 on success
+ALTEGO_EXPORT int altego_set_detector(altego_pipeline *pipeline, const char *spec);
+
+// run detection, landmarking and solving on separate threads (non-zero), call while stopped
+ALTEGO_EXPORT void altego_set_staged(altego_pipeline *pipeline, int staged);
+
+// capture MJPEG (non-zero) and decode only what detection and landmarking need, call while stopped
+// ignored if libaltego was built without libjpeg-turbo
+ALTEGO_EXPORT void altego_set_mjpeg(altego_pipeline *pipeline, int mjpeg);
+
+// read a recorded file instead of the camera device, NULL or "" selects the device again, call while stopped
+ALTEGO_EXPORT void altego_set_file(altego_pipeline *pipeline, const char *file);
+
+// set or clear (NULL) the result callback, call while stopped
+ALTEGO_EXPORT void altego_set_callback(altego_pipeline *pipeline, altego_result_callback callback, void *user);
+
+// start capturing, returns 0 on success
+ALTEGO_EXPORT int altego_start(altego_pipeline *pipeline);
+
+// stop capturing and join the capture thread
+ALTEGO_EXPORT void altego_stop(altego_pipeline *pipeline);
+
+// readiness of the pipeline
+#define ALTEGO_STATE_LOADING_MODEL 0
+#define ALTEGO_STATE_WAITING_CAMERA 1
+#define ALTEGO_STATE_TRACKING 2
+
+// one of ALTEGO_STATE_*
+ALTEGO_EXPORT int altego_state(altego_pipeline *pipeline);
+
+// copy the latest result, returns 1 if it is newer than the one returned by the previous poll, 0 otherwise
+ALTEGO_EXPORT int altego_poll(altego_pipeline *pipeline, altego_result *result);
+
+// like altego_poll, but waits up to timeout milliseconds for a newer result
+ALTEGO_EXPORT int altego_wait(altego_pipeline *pipeline, altego_result *result, unsigned long timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ALTEGO_H__
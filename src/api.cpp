@@ -0,0 +1,147 @@
+/**
+ * api.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "altego.h"
+#include "pipeline.h"
+
+#include <mutex>
+
+using namespace altego;
+
+struct altego_pipeline final : public PipelineDelegate {
+  Pipeline pipeline;
+  std::string error;
+  uint64_t pollSeq = 0;
+  // sequence of published results, matches ResultStore::Seq
+  uint64_t seq = 0;
+  altego_result_callback callback = nullptr;
+  void *user = nullptr;
+  std::mutex pollMutex;
+
+  void AltegoPipelineDeviceOpened(Pipeline *, int) override {}
+
+  void AltegoPipelineFrameResolved(Pipeline *, cv::Mat &) override {}
+
+  void AltegoPipelineResultUpdated(Pipeline *, const Result &res) override {
+    seq++;
+    if (callback == nullptr)
+      return;
+    altego_result r = {seq, res.r1, res.r2};
+    callback(&r, user);
+  }
+
+  void AltegoPipelineFPSUpdated(Pipeline *, double) override {}
+
+  void AltegoPipelineStateChanged(Pipeline *, StateType) override {}
+};
+
+int altego_api_version(void) { return ALTEGO_API_VERSION; }
+
+altego_pipeline *altego_create(void) {
+  try {
+    auto p = new altego_pipeline();
+    p->pipeline.SetDelegate(p);
+    // in-process consumers never read the wire format
+    p->pipeline.SetEncoding(false);
+    // frames are never shown, compressed frames only need the face region decoded
+    p->pipeline.SetPreview(false);
+    return p;
+  } catch (std::exception &) {
+    return nullptr;
+  }
+}
+
+void altego_destroy(altego_pipeline *pipeline) {
+  if (pipeline == nullptr)
+    return;
+  pipeline->pipeline.Stop();
+  delete pipeline;
+}
+
+const char *altego_last_error(altego_pipeline *pipeline) { return pipeline->error.c_str(); }
+
+int altego_load_model(altego_pipeline *pipeline, const char *file) {
+  try {
+    pipeline->pipeline.LoadModelFile(file);
+  } catch (std::exception &err) {
+    pipeline->error = "Failed to load model: " + std::string(err.what());
+    return -1;
+  }
+  return 0;
+}
+
+void altego_set_device(altego_pipeline *pipeline, int device) { pipeline->pipeline.SetDevice(device); }
+
+void altego_set_size(altego_pipeline *pipeline, int width, int height) { pipeline->pipeline.SetSize(width, height); }
+
+int altego_set_detector(altego_pipeline *pipeline, const char *spec) {
+  try {
+    pipeline->pipeline.GetAlgorithm()->SetDetector(CreateDetector(spec));
+  } catch (std::exception &err) {
+    pipeline->error = "Failed to create detector: " + std::string(err.what());
+    return -1;
+  }
+  return 0;
+}
+
+void altego_set_staged(altego_pipeline *pipeline, int staged) { pipeline->pipeline.SetStaged(staged != 0); }
+
+void altego_set_mjpeg(altego_pipeline *pipeline, int mjpeg) { pipeline->pipeline.SetMJPEG(mjpeg != 0); }
+
+void altego_set_file(altego_pipeline *pipeline, const char *file) { pipeline->pipeline.SetFile(file == nullptr ? "" : file); }
+
+void altego_set_callback(altego_pipeline *pipeline, altego_result_callback callback, void *user) {
+  pipeline->callback = callback;
+  pipeline->user = user;
+}
+
+int altego_start(altego_pipeline *pipeline) {
+  try {
+    pipeline->pipeline.Start();
+  } catch (std::exception &err) {
+    pipeline->error = "Failed to start: " + std::string(err.what());
+    return -1;
+  }
+  return 0;
+}
+
+void altego_stop(altego_pipeline *pipeline) { pipeline->pipeline.Stop(); }
+
+int altego_state(altego_pipeline *pipeline) { return static_cast<int>(pipeline->pipeline.GetState()); }
+
+int altego_poll(altego_pipeline *pipeline, altego_result *result) { return altego_wait(pipeline, result, 0); }
+
+int altego_wait(altego_pipeline *pipeline, altego_result *result, unsigned long timeout) {
+  std::lock_guard<std::mutex> lock(pipeline->pollMutex);
+  Update update;
+  bool fresh = pipeline->pipeline.GetResultStore()->Next(pipeline->pollSeq, update, timeout);
+  if (result != nullptr) {
+    result->seq = pipeline->pollSeq;
+    result->r1 = update.result.r1;
+    result->r2 = update.result.r2;
+  }
+  return fresh ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * bench.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "detector.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <dlib/cmd_line_parser.h>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace altego;
+
+// minimum intersection over union for a detection to match a reference face
+#define MATCH_IOU 0.5
+
+static double _iou(const cv::Rect &a, const cv::Rect &b) {
+  double inter = (a & b).area();
+  double uni = a.area() + b.area() - inter;
+  return uni > 0 ? inter / uni : 0;
+}
+
+static double _percentile(std::vector<double> &v, double p) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  return v[static_cast<size_t>(p * (v.size() - 1))];
+}
+
+// run each detector on the same recorded frames, report latency and recall against a reference detector
+int main(int argc, char **argv) {
+  dlib::command_line_parser parser;
+  parser.add_option("h", "Display this help message.");
+  parser.add_option("video", "Recorded frames to read, any file or pattern cv::VideoCapture accepts.", 1);
+  parser.add_option("frames", "Maximum number of frames to use (default 300).", 1);
+  parser.add_option("ratio", "Down sample ratio of the detection input (default 4).", 1);
+  parser.add_option("reference", "Detector run on full resolution frames as ground truth (default hog).", 1);
+  parser.add_option("detector", "Detector to benchmark, may be given multiple times (default hog).", 1);
+  try {
+    parser.parse(argc, argv);
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (parser.option("h") || !parser.option("video")) {
+    std::cout << "Usage: altego-bench --video <file> [options]" << std::endl;
+    parser.print_options();
+    return parser.option("h") ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  auto maxFrames = dlib::get_option(parser, "frames", 300);
+  auto ratio = dlib::get_option(parser, "ratio", 4.0);
+  auto referenceSpec = dlib::get_option(parser, "reference", std::string("hog"));
+  std::vector<std::string> specs;
+  for (unsigned long i = 0; i < parser.option("detector").count(); i++)
+    specs.push_back(parser.option("detector").argument(0, i));
+  if (specs.empty())
+    specs.push_back("hog");
+
+  // load frames up front, so decoding is not measured and every detector sees the same input
+  cv::VideoCapture cap;
+  if (!cap.open(parser.option("video").argument())) {
+    std::cerr << "failed to open " << parser.option("video").argument() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<cv::Mat> frames, smallFrames;
+  cv::Mat im;
+  while (static_cast<int>(frames.size()) < maxFrames && cap.read(im)) {
+    frames.push_back(im.clone());
+    smallFrames.emplace_back();
+    cv::resize(im, smallFrames.back(), cv::Size(), 1.0 / ratio, 1.0 / ratio);
+  }
+  if (frames.empty()) {
+    std::cerr << "no frames read" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // ground truth, scaled to the detection input
+  std::vector<std::vector<cv::Rect>> truth(frames.size());
+  size_t truthFaces = 0;
+  try {
+    auto reference = CreateDetector(referenceSpec);
+    for (size_t i = 0; i < frames.size(); i++) {
+      reference->Detect(frames[i], truth[i]);
+      for (auto &r : truth[i])
+        r = cv::Rect(static_cast<int>(r.x / ratio), static_cast<int>(r.y / ratio), static_cast<int>(r.width / ratio), static_cast<int>(r.height / ratio));
+      truthFaces += truth[i].size();
+    }
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << frames.size() << " frames " << frames[0].cols << "x" << frames[0].rows << ", detection input " << smallFrames[0].cols << "x"
+            << smallFrames[0].rows << ", " << truthFaces << " reference faces (" << referenceSpec << ")" << std::endl;
+  printf("%-40s %10s %10s %10s %10s %10s\n", "detector", "mean ms", "p50 ms", "p99 ms", "recall", "faces");
+
+  std::vector<cv::Rect> faces;
+  for (auto &spec : specs) {
+    std::unique_ptr<Detector> detector;
+    try {
+      detector = CreateDetector(spec);
+    } catch (std::exception &err) {
+      std::cerr << spec << ": " << err.what() << std::endl;
+      continue;
+    }
+    // warm up
+    detector->Detect(smallFrames[0], faces);
+
+    std::vector<double> latencies;
+    size_t matched = 0, found = 0;
+    for (size_t i = 0; i < smallFrames.size(); i++) {
+      double t = cv::getTickCount();
+      detector->Detect(smallFrames[i], faces);
+      latencies.push_back((cv::getTickCount() - t) * 1000.0 / cv::getTickFrequency());
+      found += faces.size();
+      for (auto &r : truth[i]) {
+        for (auto &f : faces) {
+          if (_iou(r, f) >= MATCH_IOU) {
+            matched++;
+            break;
+          }
+        }
+      }
+    }
+    double mean = 0;
+    for (auto l : latencies)
+      mean += l;
+    mean /= latencies.size();
+    double p50 = _percentile(latencies, 0.5);
+    double p99 = _percentile(latencies, 0.99);
+    if (truthFaces > 0)
+      printf("%-40s %10.2f %10.2f %10.2f %10.3f %10zu\n", spec.c_str(), mean, p50, p99, static_cast<double>(matched) / truthFaces, found);
+    else
+      printf("%-40s %10.2f %10.2f %10.2f %10s %10zu\n", spec.c_str(), mean, p50, p99, "n/a", found);
+  }
+  return EXIT_SUCCESS;
+}
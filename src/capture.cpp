@@ -25,11 +25,18 @@
  */
 
 #include "capture.h"
+#include "placement.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <chrono>
 #include <opencv2/videoio.hpp>
-#include <thread>
 
-altego::Capture::Capture() : _device(0), _width(800), _height(600), _stopMark(false), _delegate(nullptr) {}
+// delay before reopening a missing or offline device, doubled on every failure up to CAPTURE_RETRY_MAX, in milliseconds
+#define CAPTURE_RETRY_MIN 250
+#define CAPTURE_RETRY_MAX 5000
+
+altego::Capture::Capture() : _device(0), _width(800), _height(600), _stopMark(false), _mjpeg(false), _delegate(nullptr) {}
 
 void altego::Capture::SetDelegate(altego::CaptureDelegate *delegate) { _delegate = delegate; }
 
@@ -40,8 +47,24 @@ void altego::Capture::SetSize(double width, double height) {
   _height = height;
 }
 
+void altego::Capture::SetMJPEG(bool mjpeg) { _mjpeg = mjpeg; }
+
+void altego::Capture::SetFile(const std::string &file) { _file = file; }
+
+void altego::Capture::Reset() { _stopMark = false; }
+
+void altego::Capture::backOff(int milliseconds) {
+  std::unique_lock<std::mutex> lock(_stopMutex);
+  _stopCondition.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] { return _stopMark.load(); });
+}
+
 void altego::Capture::Run() {
-  _stopMark = false;
+  Placement::Apply("capture");
+
+  // current retry delay, reset once frames arrive
+  int retry = CAPTURE_RETRY_MIN;
+  // a recorded file is being reopened to replay it, the delegate still considers it open
+  bool replaying = false;
 
   // device retry loop
   while (!_stopMark) {
@@ -56,20 +79,45 @@ void altego::Capture::Run() {
     // counter
     int count = 0;
     double t = 0;
-
-    // wait 5s and retry if failed to open device
-    if (!cap.open(device)) {
-      std::this_thread::sleep_for(std::chrono::seconds(5));
+    // frames read since open
+    uint64_t frames = 0;
+    bool offline = false, replay = false;
+
+    // back off and retry if failed to open device
+    bool opened;
+    {
+      TraceSpan span("capture.open");
+      opened = _file.empty() ? cap.open(device) : cap.open(_file);
+    }
+    if (!opened) {
+      // the file went away between replays
+      if (replaying && _delegate != nullptr)
+        _delegate->AltegoCaptureDeviceClosed(this, device);
+      replaying = false;
+      TraceSpan span("capture.offline");
+      backOff(retry);
+      retry = std::min(retry * 2, CAPTURE_RETRY_MAX);
       continue;
     }
 
-    // notify device opened
-    if (_delegate != nullptr)
+    // notify device opened, unless it is a replay
+    if (_delegate != nullptr && !replaying)
       _delegate->AltegoCaptureDeviceOpened(this, device);
+    replaying = false;
 
     // set camera FPS
     cap.set(cv::CAP_PROP_FPS, 30);
 
+    // raw MJPEG buffers, decoding is left to the algorithm stages
+    if (_mjpeg) {
+      if (_file.empty()) {
+        cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+        cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
+      } else {
+        cap.set(cv::CAP_PROP_FORMAT, -1);
+      }
+    }
+
     // camera read loop
     while (!_stopMark) {
       // break inner loop immediately if device changed
@@ -92,15 +140,32 @@ void altego::Capture::Run() {
         t = cv::getTickCount();
 
       // read frame
-      if (!cap.read(im)) {
-        // wait 5s and break inner loop if camera offline
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+      bool read;
+      {
+        TraceSpan span("capture.read");
+        read = cap.read(im);
+      }
+      if (!read) {
+        // replay recorded file immediately
+        if (!_file.empty() && frames > 0) {
+          replay = true;
+          break;
+        }
+        // break inner loop if camera offline
+        offline = true;
         break;
       }
 
-      // notify frame read
-      if (_delegate != nullptr)
-        _delegate->AltegoCaptureFrameRead(this, im);
+      frames++;
+      retry = CAPTURE_RETRY_MIN;
+
+      // notify frame read, raw buffers arrive as a single row of bytes
+      if (_delegate != nullptr) {
+        if (_mjpeg && im.type() == CV_8UC1 && im.rows == 1)
+          _delegate->AltegoCaptureJpegRead(this, im.ptr(), im.total());
+        else
+          _delegate->AltegoCaptureFrameRead(this, im);
+      }
 
       // calculate FPS
       count++;
@@ -112,7 +177,27 @@ void altego::Capture::Run() {
         }
       }
     }
+
+    // notify device closed, a replay reopens the file right away and is not reported
+    if (_delegate != nullptr && !replay)
+      _delegate->AltegoCaptureDeviceClosed(this, device);
+    replaying = replay;
+
+    // back off before reopening an offline camera
+    if (offline) {
+      TraceSpan span("capture.offline");
+      backOff(retry);
+      retry = std::min(retry * 2, CAPTURE_RETRY_MAX);
+    }
   }
+
+  // stopped between a replay and its reopen
+  if (replaying && _delegate != nullptr)
+    _delegate->AltegoCaptureDeviceClosed(this, _device);
 }
 
-void altego::Capture::Stop() { _stopMark = true; }
+void altego::Capture::Stop() {
+  std::lock_guard<std::mutex> lock(_stopMutex);
+  _stopMark = true;
+  _stopCondition.notify_all();
+}
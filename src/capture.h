@@ -27,7 +27,13 @@
 #ifndef __ALTEGO_CAPTURE_H__
 #define __ALTEGO_CAPTURE_H__
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <opencv2/core.hpp>
+#include <string>
 
 namespace altego {
 class Capture;
@@ -36,8 +42,14 @@ class CaptureDelegate {
 public:
   virtual void AltegoCaptureDeviceOpened(Capture *capture, int device) = 0;
 
+  // device went offline, was switched or capture stopped
+  virtual void AltegoCaptureDeviceClosed(Capture *capture, int device) = 0;
+
   virtual void AltegoCaptureFrameRead(Capture *capture, cv::Mat &im) = 0;
 
+  // compressed frame in MJPEG mode, data is only valid during the call
+  virtual void AltegoCaptureJpegRead(Capture *capture, const uint8_t *data, size_t size) = 0;
+
   virtual void AltegoCaptureFPSUpdated(Capture *capture, double fps) = 0;
 };
 
@@ -51,15 +63,32 @@ public:
 
   void SetSize(double width, double height);
 
+  // request MJPEG and deliver compressed frames, sources without raw access still deliver decoded frames, call while stopped
+  void SetMJPEG(bool mjpeg);
+
+  // read a recorded file instead of the camera device, replayed from the start when it ends, call while stopped
+  void SetFile(const std::string &file);
+
+  // clear a previous Stop, call before starting the thread running Run
+  void Reset();
+
   void Run();
 
+  // thread safe, also interrupts a back-off
   void Stop();
 
 private:
   int _device;
   double _width, _height;
-  bool _stopMark;
+  std::atomic<bool> _stopMark;
+  std::mutex _stopMutex;
+  std::condition_variable _stopCondition;
+  bool _mjpeg;
+  std::string _file;
   CaptureDelegate *_delegate;
+
+  // sleep for milliseconds or until stopped
+  void backOff(int milliseconds);
 };
 } // namespace altego
 
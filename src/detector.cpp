@@ -0,0 +1,115 @@
+/**
+ * detector.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "detector.h"
+
+#include <dlib/opencv.h>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+
+// margin added around cascade candidates before confirming, fraction of candidate size
+#define CASCADE_MARGIN 0.5
+
+altego::HogDetector::HogDetector() : _detector(dlib::get_frontal_face_detector()) {}
+
+void altego::HogDetector::Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) {
+  // convert type with zero copy
+  dlib::cv_image<dlib::bgr_pixel> dim(im);
+  _detector(dim, _dets);
+  faces.clear();
+  for (auto &det : _dets)
+    faces.emplace_back(static_cast<int>(det.rect.left()), static_cast<int>(det.rect.top()), static_cast<int>(det.rect.width()),
+                       static_cast<int>(det.rect.height()));
+}
+
+#ifdef ALTEGO_HAVE_YUNET
+altego::YuNetDetector::YuNetDetector(const std::string &modelFile) { _detector = cv::FaceDetectorYN::create(modelFile, "", cv::Size(320, 320)); }
+
+void altego::YuNetDetector::Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) {
+  if (im.size() != _inputSize) {
+    _inputSize = im.size();
+    _detector->setInputSize(_inputSize);
+  }
+  _detector->detect(im, _out);
+  faces.clear();
+  // one row per face: x, y, w, h, landmarks and score
+  for (int i = 0; i < _out.rows; i++) {
+    const float *row = _out.ptr<float>(i);
+    faces.emplace_back(static_cast<int>(row[0]), static_cast<int>(row[1]), static_cast<int>(row[2]), static_cast<int>(row[3]));
+  }
+}
+#endif
+
+altego::CascadeDetector::CascadeDetector(const std::string &cascadeFile, std::unique_ptr<Detector> confirm) : _confirm(std::move(confirm)) {
+  if (!_cascade.load(cascadeFile))
+    throw std::runtime_error("failed to load cascade " + cascadeFile);
+}
+
+void altego::CascadeDetector::Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) {
+  cv::cvtColor(im, _gray, cv::COLOR_BGR2GRAY);
+  _cascade.detectMultiScale(_gray, _candidates, 1.2, 3, 0, cv::Size(24, 24));
+  if (_confirm == nullptr) {
+    faces.swap(_candidates);
+    return;
+  }
+  // confirm candidates with the wrapped detector, restricted to the expanded candidate regions
+  faces.clear();
+  cv::Rect bounds(0, 0, im.cols, im.rows);
+  for (auto &c : _candidates) {
+    auto mx = static_cast<int>(c.width * CASCADE_MARGIN);
+    auto my = static_cast<int>(c.height * CASCADE_MARGIN);
+    cv::Rect roi = cv::Rect(c.x - mx, c.y - my, c.width + 2 * mx, c.height + 2 * my) & bounds;
+    if (roi.area() == 0)
+      continue;
+    _confirm->Detect(im(roi), _confirmed);
+    for (auto &f : _confirmed)
+      faces.emplace_back(f.x + roi.x, f.y + roi.y, f.width, f.height);
+  }
+}
+
+std::unique_ptr<altego::Detector> altego::CreateDetector(const std::string &spec) {
+  auto pos = spec.find(':');
+  std::string kind = spec.substr(0, pos);
+  std::string arg = pos == std::string::npos ? "" : spec.substr(pos + 1);
+  if (kind == "hog")
+    return std::unique_ptr<Detector>(new HogDetector());
+  if (kind == "yunet") {
+#ifdef ALTEGO_HAVE_YUNET
+    try {
+      return std::unique_ptr<Detector>(new YuNetDetector(arg));
+    } catch (cv::Exception &err) {
+      throw std::runtime_error("failed to load YuNet model " + arg + ": " + err.what());
+    }
+#else
+    throw std::runtime_error("yunet detector requires OpenCV 4.5.4 or later");
+#endif
+  }
+  if (kind == "cascade")
+    return std::unique_ptr<Detector>(new CascadeDetector(arg));
+  if (kind == "cascade+hog")
+    return std::unique_ptr<Detector>(new CascadeDetector(arg, std::unique_ptr<Detector>(new HogDetector())));
+  throw std::runtime_error("unknown detector " + spec);
+}
@@ -0,0 +1,106 @@
+/**
+ * detector.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_DETECTOR_H__
+#define __ALTEGO_DETECTOR_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <dlib/image_processing.h>
+#include <dlib/image_processing/frontal_face_detector.h>
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+
+// cv::FaceDetectorYN is available since OpenCV 4.5.4
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 4)))
+#define ALTEGO_HAVE_YUNET 1
+#endif
+
+namespace altego {
+/**
+ * Detector
+ *
+ * face detector backend, runs on the downsampled BGR frame
+ */
+class Detector {
+public:
+  virtual ~Detector() = default;
+
+  // replace faces with the faces found in im, implementations reuse the capacity of faces
+  virtual void Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) = 0;
+};
+
+// dlib HOG+SVM frontal face detector
+class HogDetector : public Detector {
+public:
+  HogDetector();
+
+  void Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) override;
+
+private:
+  dlib::frontal_face_detector _detector;
+  std::vector<dlib::rect_detection> _dets;
+};
+
+#ifdef ALTEGO_HAVE_YUNET
+// OpenCV YuNet DNN detector
+class YuNetDetector : public Detector {
+public:
+  // load ONNX model, throws cv::Exception on failure
+  explicit YuNetDetector(const std::string &modelFile);
+
+  void Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) override;
+
+private:
+  cv::Ptr<cv::FaceDetectorYN> _detector;
+  cv::Size _inputSize;
+  cv::Mat _out;
+};
+#endif
+
+// Haar or LBP cascade, optionally only as a pre-filter that limits a confirming detector to candidate regions
+class CascadeDetector : public Detector {
+public:
+  // load cascade XML, throws std::runtime_error on failure
+  explicit CascadeDetector(const std::string &cascadeFile, std::unique_ptr<Detector> confirm = nullptr);
+
+  void Detect(const cv::Mat &im, std::vector<cv::Rect> &faces) override;
+
+private:
+  cv::CascadeClassifier _cascade;
+  std::unique_ptr<Detector> _confirm;
+  cv::Mat _gray;
+  std::vector<cv::Rect> _candidates, _confirmed;
+};
+
+// create a detector from a spec: "hog", "yunet:<model.onnx>", "cascade:<cascade.xml>" or "cascade+hog:<cascade.xml>"
+// throws std::runtime_error for unknown or unsupported specs
+std::unique_ptr<Detector> CreateDetector(const std::string &spec);
+} // namespace altego
+
+#endif // __ALTEGO_DETECTOR_H__
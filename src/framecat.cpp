@@ -0,0 +1,83 @@
+/**
+ * framecat.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "frameexport.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// poll interval for new frames
+#define POLL_INTERVAL 5
+
+// print the description of frames published by altego --export as they arrive, reading at its own pace
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << "Usage: altego-framecat <name> [frames]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  long frames = argc > 2 ? std::atol(argv[2]) : 0;
+  try {
+    altego::FrameExportReader reader(argv[1]);
+    altego::FrameExportSlot meta;
+    uint64_t last = 0, missed = 0;
+    for (long n = 0; frames <= 0 || n < frames;) {
+      uint64_t seq = reader.Latest();
+      if (seq == last) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL));
+        continue;
+      }
+      // zero-copy, the image is only summed here
+      const uint8_t *data = reader.Data(seq, meta);
+      uint64_t sum = 0;
+      if (data != nullptr) {
+        for (uint32_t y = 0; y < meta.height; y++)
+          for (uint32_t x = 0; x < meta.stride; x++)
+            sum += data[static_cast<uint64_t>(y) * meta.stride + x];
+      }
+      if (data == nullptr || !reader.Check(seq)) {
+        // overwritten while reading, retry with the newest frame
+        missed++;
+        continue;
+      }
+      if (last != 0)
+        missed += seq - last - 1;
+      last = seq;
+      n++;
+      std::cout << "seq:" << seq << ";ts:" << meta.timestamp << ";size:" << meta.width << "x" << meta.height << ";annotated:" << meta.annotated
+                << ";parts:" << meta.parts << ";mean:" << std::to_string(static_cast<double>(sum) / (meta.stride * static_cast<double>(meta.height)))
+                << ";missed:" << missed << ";";
+      if (meta.resolved)
+        std::cout << "r1:" << std::to_string(meta.r1) << ";r2:" << std::to_string(meta.r2) << ";";
+      std::cout << std::endl;
+    }
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
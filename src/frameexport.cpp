@@ -0,0 +1,192 @@
+/**
+ * frameexport.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "frameexport.h"
+#include "algorithm.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FRAME_EXPORT_MAGIC "ALTEGOF"
+#define FRAME_EXPORT_VERSION 1
+
+// image data starts on a page boundary
+#define FRAME_EXPORT_ALIGN 4096
+
+static std::runtime_error _error(const std::string &what, const std::string &name) {
+  return std::runtime_error(what + " " + name + ": " + strerror(errno));
+}
+
+altego::FrameExport::FrameExport(const std::string &name, uint32_t slots, uint64_t slotBytes) : _name(name), _size(0), _base(nullptr) {
+  if (slots == 0 || slotBytes == 0)
+    throw std::runtime_error("frame export needs at least one slot");
+  uint64_t dataOffset = (sizeof(FrameExportHeader) + slots * sizeof(FrameExportSlot) + FRAME_EXPORT_ALIGN - 1) / FRAME_EXPORT_ALIGN * FRAME_EXPORT_ALIGN;
+  _size = static_cast<size_t>(dataOffset + slots * slotBytes);
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if (fd < 0)
+    throw _error("failed to create", name);
+  if (ftruncate(fd, static_cast<off_t>(_size)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw _error("failed to size", name);
+  }
+  void *base = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw _error("failed to map", name);
+  }
+  _base = static_cast<uint8_t *>(base);
+  // fresh object is zero filled, so every slot seq reads 0
+  FrameExportHeader *h = header();
+  h->version = FRAME_EXPORT_VERSION;
+  h->slots = slots;
+  h->slotBytes = slotBytes;
+  h->dataOffset = dataOffset;
+  h->latest.store(0, std::memory_order_relaxed);
+  // magic last, readers attaching early see an incomplete header
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(h->magic, FRAME_EXPORT_MAGIC, sizeof(h->magic));
+}
+
+altego::FrameExport::~FrameExport() {
+  munmap(_base, _size);
+  shm_unlink(_name.c_str());
+}
+
+altego::FrameExportSlot *altego::FrameExport::slot(uint64_t seq) const {
+  return reinterpret_cast<FrameExportSlot *>(_base + sizeof(FrameExportHeader)) + seq % header()->slots;
+}
+
+void altego::FrameExport::Write(const altego::Frame &frame, bool annotated) {
+  const cv::Mat &im = frame.im;
+  auto rowBytes = static_cast<uint64_t>(im.cols) * im.elemSize();
+  if (im.empty() || im.type() != CV_8UC3 || rowBytes * static_cast<uint64_t>(im.rows) > header()->slotBytes) {
+    _dropped++;
+    return;
+  }
+  uint64_t seq = ++_seq;
+  FrameExportSlot *s = slot(seq);
+  uint8_t *data = _base + header()->dataOffset + (seq % header()->slots) * header()->slotBytes;
+  // invalidate the slot before touching it, readers compare seq before and after their read
+  s->seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  s->width = static_cast<uint32_t>(im.cols);
+  s->height = static_cast<uint32_t>(im.rows);
+  s->stride = static_cast<uint32_t>(rowBytes);
+  s->annotated = annotated ? 1 : 0;
+  s->resolved = frame.resolved ? 1 : 0;
+  s->r1 = frame.result.r1;
+  s->r2 = frame.result.r2;
+  s->parts = static_cast<uint32_t>(std::min<size_t>(frame.parts.size(), FRAME_EXPORT_PARTS));
+  for (uint32_t i = 0; i < s->parts; i++) {
+    s->points[i][0] = frame.parts[i].x;
+    s->points[i][1] = frame.parts[i].y;
+  }
+  if (im.isContinuous()) {
+    memcpy(data, im.data, rowBytes * static_cast<uint64_t>(im.rows));
+  } else {
+    for (int y = 0; y < im.rows; y++)
+      memcpy(data + static_cast<uint64_t>(y) * rowBytes, im.ptr(y), rowBytes);
+  }
+  s->seq.store(seq, std::memory_order_release);
+  header()->latest.store(seq, std::memory_order_release);
+}
+
+altego::FrameExportReader::FrameExportReader(const std::string &name) : _size(0), _base(nullptr) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    throw _error("failed to open", name);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameExportHeader)) {
+    close(fd);
+    throw std::runtime_error("invalid frame export " + name);
+  }
+  _size = static_cast<size_t>(st.st_size);
+  void *base = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    throw _error("failed to map", name);
+  _base = static_cast<const uint8_t *>(base);
+  const FrameExportHeader *h = header();
+  if (memcmp(h->magic, FRAME_EXPORT_MAGIC, sizeof(h->magic)) != 0 || h->version != FRAME_EXPORT_VERSION ||
+      h->dataOffset + h->slots * h->slotBytes > _size) {
+    munmap(const_cast<uint8_t *>(_base), _size);
+    throw std::runtime_error("invalid frame export " + name);
+  }
+}
+
+altego::FrameExportReader::~FrameExportReader() { munmap(const_cast<uint8_t *>(_base), _size); }
+
+uint64_t altego::FrameExportReader::Latest() const { return header()->latest.load(std::memory_order_acquire); }
+
+const altego::FrameExportSlot *altego::FrameExportReader::slot(uint64_t seq) const {
+  return reinterpret_cast<const FrameExportSlot *>(_base + sizeof(FrameExportHeader)) + seq % header()->slots;
+}
+
+const uint8_t *altego::FrameExportReader::Data(uint64_t seq, altego::FrameExportSlot &meta) const {
+  const FrameExportSlot *s = slot(seq);
+  if (seq == 0 || s->seq.load(std::memory_order_acquire) != seq)
+    return nullptr;
+  meta.seq.store(seq, std::memory_order_relaxed);
+  meta.timestamp = s->timestamp;
+  meta.width = s->width;
+  meta.height = s->height;
+  meta.stride = s->stride;
+  meta.annotated = s->annotated;
+  meta.resolved = s->resolved;
+  meta.parts = std::min<uint32_t>(s->parts, FRAME_EXPORT_PARTS);
+  meta.r1 = s->r1;
+  meta.r2 = s->r2;
+  memcpy(meta.points, s->points, sizeof(meta.points));
+  if (!Check(seq) || static_cast<uint64_t>(meta.stride) * meta.height > header()->slotBytes)
+    return nullptr;
+  return _base + header()->dataOffset + (seq % header()->slots) * header()->slotBytes;
+}
+
+bool altego::FrameExportReader::Check(uint64_t seq) const {
+  // order the reads of the slot before the second seq load
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot(seq)->seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool altego::FrameExportReader::Read(uint64_t seq, cv::Mat &im, altego::FrameExportSlot &meta) const {
+  const uint8_t *data = Data(seq, meta);
+  if (data == nullptr || meta.stride != meta.width * 3)
+    return false;
+  im.create(static_cast<int>(meta.height), static_cast<int>(meta.width), CV_8UC3);
+  for (int y = 0; y < im.rows; y++)
+    memcpy(im.ptr(y), data + static_cast<uint64_t>(y) * meta.stride, meta.stride);
+  return Check(seq);
+}
@@ -0,0 +1,144 @@
+/**
+ * frameexport.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_FRAMEEXPORT_H__
+#define __ALTEGO_FRAMEEXPORT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace altego {
+class Frame;
+
+// landmark parts carried per frame, enough for the 68 point model
+#define FRAME_EXPORT_PARTS 68
+
+// shared memory header, followed by the slot headers and, from dataOffset, one image of slotBytes per slot
+struct FrameExportHeader {
+  // "ALTEGOF"
+  char magic[8];
+  uint32_t version;
+  uint32_t slots;
+  uint64_t slotBytes;
+  uint64_t dataOffset;
+  // sequence of the newest complete frame, 0 before the first one, frame seq lives in slot seq % slots
+  std::atomic<uint64_t> latest;
+};
+
+// per slot frame description, BGR 8 bit image
+struct FrameExportSlot {
+  // sequence of the frame in the slot, 0 while being written
+  std::atomic<uint64_t> seq;
+  // wall clock time in nanoseconds since epoch
+  int64_t timestamp;
+  uint32_t width, height, stride;
+  // landmarks drawn into the image
+  uint32_t annotated;
+  // r1, r2 are the pose of this frame
+  uint32_t resolved;
+  uint32_t parts;
+  double r1, r2;
+  int32_t points[FRAME_EXPORT_PARTS][2];
+};
+
+/**
+ * FrameExport
+ *
+ * publishes frames into a POSIX shared memory ring of preallocated slots, the writer never waits
+ * for readers, a reader validates a slot by reading its seq before and after using it
+ */
+class FrameExport {
+public:
+  // create shared memory object name (e.g. "/altego-frames") with slots slots of slotBytes each, throws std::runtime_error
+  FrameExport(const std::string &name, uint32_t slots, uint64_t slotBytes);
+
+  // unlinks the shared memory object, attached readers keep their mapping
+  ~FrameExport();
+
+  FrameExport(const FrameExport &) = delete;
+
+  FrameExport &operator=(const FrameExport &) = delete;
+
+  // copy frame into the next slot, frames larger than a slot are dropped, call from one thread
+  void Write(const Frame &frame, bool annotated);
+
+  // frames dropped because they did not fit a slot
+  uint64_t Dropped() const { return _dropped; }
+
+private:
+  const std::string _name;
+  size_t _size;
+  uint8_t *_base;
+  uint64_t _seq = 0;
+  uint64_t _dropped = 0;
+
+  FrameExportHeader *header() const { return reinterpret_cast<FrameExportHeader *>(_base); }
+
+  FrameExportSlot *slot(uint64_t seq) const;
+};
+
+/**
+ * FrameExportReader
+ *
+ * read-only attachment to a FrameExport, zero-copy through Data and Check, or copying through Read
+ */
+class FrameExportReader {
+public:
+  // attach to shared memory object name, throws std::runtime_error
+  explicit FrameExportReader(const std::string &name);
+
+  ~FrameExportReader();
+
+  FrameExportReader(const FrameExportReader &) = delete;
+
+  FrameExportReader &operator=(const FrameExportReader &) = delete;
+
+  // sequence of the newest complete frame, 0 if none yet
+  uint64_t Latest() const;
+
+  // image of frame seq in shared memory and its description, nullptr if the slot holds another frame
+  // the image may be overwritten while in use, call Check afterwards
+  const uint8_t *Data(uint64_t seq, FrameExportSlot &meta) const;
+
+  // whether frame seq was still intact, after using the pointer returned by Data
+  bool Check(uint64_t seq) const;
+
+  // copy frame seq, false if it was overwritten
+  bool Read(uint64_t seq, cv::Mat &im, FrameExportSlot &meta) const;
+
+private:
+  size_t _size;
+  const uint8_t *_base;
+
+  const FrameExportHeader *header() const { return reinterpret_cast<const FrameExportHeader *>(_base); }
+
+  const FrameExportSlot *slot(uint64_t seq) const;
+};
+} // namespace altego
+
+#endif // __ALTEGO_FRAMEEXPORT_H__
@@ -0,0 +1,246 @@
+/**
+ * journal.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "journal.h"
+#include "placement.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// segment file magic
+#define JOURNAL_MAGIC "ALTEGOJ"
+
+// segment file version
+#define JOURNAL_VERSION 1
+
+// segment file extension
+#define JOURNAL_EXT ".journal"
+
+// queued records before Append starts dropping
+#define JOURNAL_QUEUE_SIZE 4096
+
+static std::string _errnoString(const std::string &what, const std::string &path) { return what + " " + path + ": " + std::strerror(errno); }
+
+altego::Journal::Journal(const std::string &dir, size_t segmentRecords)
+    : _dir(dir), _segmentRecords(segmentRecords), _queue(JOURNAL_QUEUE_SIZE) {}
+
+altego::Journal::~Journal() { Stop(); }
+
+void altego::Journal::Start() {
+  if (mkdir(_dir.c_str(), 0755) != 0 && errno != EEXIST)
+    throw std::runtime_error(_errnoString("failed to create journal directory", _dir));
+  _stopMark = false;
+  _started = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  _thread = std::thread(&Journal::run, this);
+}
+
+void altego::Journal::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopMark = true;
+  }
+  _cond.notify_one();
+  if (_thread.joinable())
+    _thread.join();
+}
+
+void altego::Journal::Append(const altego::Result &res) {
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _seq++;
+    if (_count == _queue.size()) {
+      _dropped++;
+      return;
+    }
+    JournalRecord &rec = _queue[(_head + _count) % _queue.size()];
+    rec.seq = _seq;
+    rec.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    rec.r1 = res.r1;
+    rec.r2 = res.r2;
+    _count++;
+  }
+  _cond.notify_one();
+}
+
+uint64_t altego::Journal::Dropped() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _dropped;
+}
+
+void altego::Journal::run() {
+  Placement::Apply("journal");
+  FILE *fp = nullptr;
+  size_t written = 0;
+  // timestamp of the last record written, a record before it starts a new segment
+  int64_t last = 0;
+  // set after a failed open, so a bad directory is reported once rather than per record
+  bool failing = false;
+  std::vector<JournalRecord> batch;
+  batch.reserve(_queue.size());
+
+  for (;;) {
+    // take all queued records
+    batch.clear();
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cond.wait(lock, [this] { return _stopMark || _count > 0; });
+      for (; _count > 0; _count--) {
+        batch.push_back(_queue[_head]);
+        _head = (_head + 1) % _queue.size();
+      }
+      stop = _stopMark;
+    }
+
+    TraceSpan span("journal.write");
+    for (size_t i = 0; i < batch.size(); i++) {
+      const JournalRecord &rec = batch[i];
+      // rotate segment, also when the wall clock stepped back, so records are sorted by timestamp within each segment
+      if (fp != nullptr && (written == _segmentRecords || rec.timestamp < last)) {
+        fclose(fp);
+        fp = nullptr;
+      }
+      if (fp == nullptr) {
+        // segments are named by start of run and first sequence, so lexical order is journal order even across clock steps
+        char name[64];
+        snprintf(name, sizeof(name), "/%020lld-%020llu" JOURNAL_EXT, static_cast<long long>(_started), static_cast<unsigned long long>(rec.seq));
+        std::string file = _dir + name;
+        if ((fp = fopen(file.c_str(), "wb")) == nullptr) {
+          // the rest of the batch is dropped, the next batch tries again
+          if (!failing)
+            std::cerr << "journal: " << _errnoString("failed to open", file) << std::endl;
+          failing = true;
+          std::lock_guard<std::mutex> lock(_mutex);
+          _dropped += batch.size() - i;
+          break;
+        }
+        failing = false;
+        // the header reaches the file before any record, so readers never see a segment without one
+        JournalHeader header = {};
+        strncpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        header.recordSize = sizeof(JournalRecord);
+        fwrite(&header, sizeof(header), 1, fp);
+        fflush(fp);
+        written = 0;
+      }
+      fwrite(&rec, sizeof(rec), 1, fp);
+      written++;
+      last = rec.timestamp;
+    }
+    if (fp != nullptr)
+      fflush(fp);
+
+    if (stop)
+      break;
+  }
+
+  if (fp != nullptr)
+    fclose(fp);
+}
+
+altego::JournalSegment::JournalSegment(const std::string &file) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(_errnoString("failed to open", file));
+  struct stat st = {};
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error(_errnoString("failed to stat", file));
+  }
+  // a segment just created by a running journal may not have its header yet, it has no records
+  if (static_cast<size_t>(st.st_size) < sizeof(JournalHeader)) {
+    close(fd);
+    return;
+  }
+  _length = static_cast<size_t>(st.st_size);
+  _map = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (_map == MAP_FAILED) {
+    _map = nullptr;
+    throw std::runtime_error(_errnoString("failed to map", file));
+  }
+  auto header = static_cast<const JournalHeader *>(_map);
+  if (strncmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)) != 0 || header->version != JOURNAL_VERSION ||
+      header->recordSize != sizeof(JournalRecord)) {
+    munmap(_map, _length);
+    _map = nullptr;
+    throw std::runtime_error("invalid journal segment " + file);
+  }
+  // a partially written trailing record is ignored
+  _records = reinterpret_cast<const JournalRecord *>(static_cast<const char *>(_map) + sizeof(JournalHeader));
+  _size = (_length - sizeof(JournalHeader)) / sizeof(JournalRecord);
+  madvise(_map, _length, MADV_SEQUENTIAL);
+}
+
+altego::JournalSegment::~JournalSegment() {
+  if (_map != nullptr)
+    munmap(_map, _length);
+}
+
+size_t altego::JournalSegment::LowerBound(int64_t t) const {
+  auto it = std::lower_bound(_records, _records + _size, t, [](const JournalRecord &rec, int64_t v) { return rec.timestamp < v; });
+  return static_cast<size_t>(it - _records);
+}
+
+altego::JournalReader::JournalReader(const std::string &dir) {
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr)
+    throw std::runtime_error(_errnoString("failed to open journal directory", dir));
+  struct dirent *ent;
+  while ((ent = readdir(d)) != nullptr) {
+    std::string name = ent->d_name;
+    std::string ext = JOURNAL_EXT;
+    if (name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0)
+      _files.push_back(dir + "/" + name);
+  }
+  closedir(d);
+  std::sort(_files.begin(), _files.end());
+}
+
+void altego::JournalReader::Scan(int64_t from, int64_t to, const std::function<void(const JournalRecord &)> &fn) {
+  for (auto &file : _files) {
+    JournalSegment segment(file);
+    if (segment.Size() == 0)
+      continue;
+    // only records within a segment are sorted by timestamp, a wall clock step may put a later segment before an earlier one
+    if (segment[segment.Size() - 1].timestamp < from || segment[0].timestamp >= to)
+      continue;
+    for (size_t i = segment.LowerBound(from); i < segment.Size() && segment[i].timestamp < to; i++)
+      fn(segment[i]);
+  }
+}
@@ -0,0 +1,151 @@
+/**
+ * journal.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_JOURNAL_H__
+#define __ALTEGO_JOURNAL_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "result.h"
+
+namespace altego {
+
+// journal segment file header
+struct JournalHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+};
+
+// fixed-size journal record
+struct JournalRecord {
+  // sequence number, increasing across segments of one run
+  uint64_t seq;
+  // wall clock time in nanoseconds since epoch
+  int64_t timestamp;
+  // result fields
+  double r1;
+  double r2;
+};
+
+/**
+ * Journal
+ *
+ * appends every published result to rotating segment files in a directory,
+ * records are queued by Append and written by a background thread,
+ * each segment is sorted by timestamp, a wall clock step back starts a new one
+ */
+class Journal {
+public:
+  // records per segment file before rotation
+  explicit Journal(const std::string &dir, size_t segmentRecords = 65536);
+
+  ~Journal();
+
+  // start writer thread, throws std::runtime_error if the directory is not usable
+  void Start();
+
+  // flush queued records and stop writer thread
+  void Stop();
+
+  // queue a result, never blocks on disk, drops the record if the queue is full
+  void Append(const Result &res);
+
+  // number of records dropped because the writer fell behind or a segment could not be opened
+  uint64_t Dropped();
+
+private:
+  const std::string _dir;
+  const size_t _segmentRecords;
+  // preallocated queue ring
+  std::vector<JournalRecord> _queue;
+  size_t _head = 0, _count = 0;
+  uint64_t _seq = 0, _dropped = 0;
+  // wall clock time of Start, names the segments of this run
+  int64_t _started = 0;
+  bool _stopMark = false;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::thread _thread;
+
+  void run();
+};
+
+/**
+ * JournalSegment
+ *
+ * read-only memory mapping of a single segment file
+ */
+class JournalSegment {
+public:
+  // map file, throws std::runtime_error on failure, a file shorter than the header has no records
+  explicit JournalSegment(const std::string &file);
+
+  ~JournalSegment();
+
+  JournalSegment(const JournalSegment &) = delete;
+
+  JournalSegment &operator=(const JournalSegment &) = delete;
+
+  size_t Size() const { return _size; }
+
+  const JournalRecord &operator[](size_t index) const { return _records[index]; }
+
+  // index of the first record with timestamp >= t
+  size_t LowerBound(int64_t t) const;
+
+private:
+  void *_map = nullptr;
+  size_t _length = 0;
+  const JournalRecord *_records = nullptr;
+  size_t _size = 0;
+};
+
+/**
+ * JournalReader
+ *
+ * time-range scans over all segments of a journal directory
+ */
+class JournalReader {
+public:
+  // list segment files, throws std::runtime_error if the directory can not be read
+  explicit JournalReader(const std::string &dir);
+
+  // call fn for every record with from <= timestamp < to, in journal order, which is timestamp order unless the wall clock stepped back
+  void Scan(int64_t from, int64_t to, const std::function<void(const JournalRecord &)> &fn);
+
+private:
+  std::vector<std::string> _files;
+};
+} // namespace altego
+
+#endif
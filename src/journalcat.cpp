@@ -0,0 +1,55 @@
+/**
+ * journalcat.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "journal.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+// print journal records as text, optionally limited to a time range in milliseconds since epoch
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 4) {
+    std::cerr << "Usage: altego-journalcat <dir> [from_ms] [to_ms]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int64_t from = std::numeric_limits<int64_t>::min();
+  int64_t to = std::numeric_limits<int64_t>::max();
+  if (argc > 2)
+    from = std::atoll(argv[2]) * 1000000;
+  if (argc > 3)
+    to = std::atoll(argv[3]) * 1000000;
+  try {
+    altego::JournalReader reader(argv[1]);
+    reader.Scan(from, to, [](const altego::JournalRecord &rec) {
+      std::cout << "seq:" << rec.seq << ";ts:" << rec.timestamp << ";r1:" << std::to_string(rec.r1) << ";r2:" << std::to_string(rec.r2) << ";\n";
+    });
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
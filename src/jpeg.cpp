@@ -0,0 +1,169 @@
+/**
+ * jpeg.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "jpeg.h"
+
+// defined by the build when libjpeg-turbo 1.5 or later, with jpeg_crop_scanline and jpeg_skip_scanlines, was found
+#ifdef ALTEGO_HAVE_JPEG
+
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#include <opencv2/imgproc.hpp>
+
+struct altego::JpegDecoder::State {
+  jpeg_decompress_struct cinfo;
+  // libjpeg calls exit() on errors by default, jump back instead
+  jpeg_error_mgr err;
+  jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+static void _errorExit(j_common_ptr cinfo) {
+  auto state = reinterpret_cast<altego::JpegDecoder::State *>(cinfo->client_data);
+  (*cinfo->err->format_message)(cinfo, state->message);
+  longjmp(state->jump, 1);
+}
+
+static void _outputMessage(j_common_ptr cinfo) { (void)cinfo; }
+
+altego::JpegDecoder::JpegDecoder() : _state(new State()) {
+  _state->cinfo.err = jpeg_std_error(&_state->err);
+  _state->err.error_exit = _errorExit;
+  _state->err.output_message = _outputMessage;
+  _state->cinfo.client_data = _state.get();
+  jpeg_create_decompress(&_state->cinfo);
+}
+
+altego::JpegDecoder::~JpegDecoder() { jpeg_destroy_decompress(&_state->cinfo); }
+
+// set BGR output, returns false if libjpeg can only produce RGB
+static bool _setBGR(jpeg_decompress_struct &cinfo) {
+#ifdef JCS_EXTENSIONS
+  cinfo.out_color_space = JCS_EXT_BGR;
+  return true;
+#else
+  cinfo.out_color_space = JCS_RGB;
+  return false;
+#endif
+}
+
+bool altego::JpegDecoder::Decode(const uint8_t *data, size_t size, int denom, bool fast, cv::Mat &out) {
+  jpeg_decompress_struct &cinfo = _state->cinfo;
+  bool bgr = false;
+  if (setjmp(_state->jump)) {
+    jpeg_abort_decompress(&cinfo);
+    _error = _state->message;
+    return false;
+  }
+  jpeg_mem_src(&cinfo, const_cast<uint8_t *>(data), static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  // scaled IDCT, skips most of the work for the discarded resolution
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = static_cast<unsigned int>(denom);
+  if (fast) {
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+  }
+  bgr = _setBGR(cinfo);
+  jpeg_start_decompress(&cinfo);
+  out.create(static_cast<int>(cinfo.output_height), static_cast<int>(cinfo.output_width), CV_8UC3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = out.ptr(static_cast<int>(cinfo.output_scanline));
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  if (!bgr)
+    cv::cvtColor(out, out, cv::COLOR_RGB2BGR);
+  return true;
+}
+
+bool altego::JpegDecoder::DecodeRegion(const uint8_t *data, size_t size, const cv::Rect &roi, cv::Mat &out) {
+  jpeg_decompress_struct &cinfo = _state->cinfo;
+  bool bgr = false;
+  if (setjmp(_state->jump)) {
+    jpeg_abort_decompress(&cinfo);
+    _error = _state->message;
+    return false;
+  }
+  jpeg_mem_src(&cinfo, const_cast<uint8_t *>(data), static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  bgr = _setBGR(cinfo);
+  jpeg_start_decompress(&cinfo);
+  out.create(static_cast<int>(cinfo.output_height), static_cast<int>(cinfo.output_width), CV_8UC3);
+  cv::Rect region = roi & cv::Rect(0, 0, out.cols, out.rows);
+  if (region.area() == 0) {
+    jpeg_abort_decompress(&cinfo);
+    return true;
+  }
+  // columns are widened to iMCU boundaries by libjpeg, rows before the region are skipped without IDCT
+  JDIMENSION xoffset = static_cast<JDIMENSION>(region.x);
+  JDIMENSION width = static_cast<JDIMENSION>(region.width);
+  jpeg_crop_scanline(&cinfo, &xoffset, &width);
+  if (region.y > 0)
+    jpeg_skip_scanlines(&cinfo, static_cast<JDIMENSION>(region.y));
+  auto end = static_cast<JDIMENSION>(region.y + region.height);
+  while (cinfo.output_scanline < end) {
+    JSAMPROW row = out.ptr(static_cast<int>(cinfo.output_scanline)) + xoffset * 3;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  // rows after the region are not needed
+  jpeg_abort_decompress(&cinfo);
+  if (!bgr) {
+    cv::Mat decoded = out(cv::Rect(static_cast<int>(xoffset), region.y, static_cast<int>(width), region.height));
+    cv::cvtColor(decoded, decoded, cv::COLOR_RGB2BGR);
+  }
+  return true;
+}
+
+bool altego::JpegDecoder::Available() { return true; }
+
+#else
+
+struct altego::JpegDecoder::State {};
+
+altego::JpegDecoder::JpegDecoder() : _state(new State()) {}
+
+altego::JpegDecoder::~JpegDecoder() {}
+
+bool altego::JpegDecoder::Decode(const uint8_t *data, size_t size, int denom, bool fast, cv::Mat &out) {
+  (void)data;
+  (void)size;
+  (void)denom;
+  (void)fast;
+  (void)out;
+  _error = "built without libjpeg-turbo";
+  return false;
+}
+
+bool altego::JpegDecoder::DecodeRegion(const uint8_t *data, size_t size, const cv::Rect &roi, cv::Mat &out) {
+  (void)roi;
+  return Decode(data, size, 1, false, out);
+}
+
+bool altego::JpegDecoder::Available() { return false; }
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * jpeg.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_JPEG_H__
+#define __ALTEGO_JPEG_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace altego {
+/**
+ * JpegDecoder
+ *
+ * libjpeg(-turbo) decoder for MJPEG frames, decodes straight to BGR, either scaled down in the
+ * DCT domain or limited to a region of interest, reuses its state and the output buffers
+ * not thread safe, use one decoder per thread
+ */
+class JpegDecoder {
+public:
+  JpegDecoder();
+
+  ~JpegDecoder();
+
+  JpegDecoder(const JpegDecoder &) = delete;
+
+  JpegDecoder &operator=(const JpegDecoder &) = delete;
+
+  // decode scaled by 1/denom, denom is 1, 2, 4 or 8, fast selects the faster but less accurate IDCT and upsampling
+  bool Decode(const uint8_t *data, size_t size, int denom, bool fast, cv::Mat &out);
+
+  // decode at full scale into out, sized to the full image, only rows and columns covering roi are guaranteed to be written
+  bool DecodeRegion(const uint8_t *data, size_t size, const cv::Rect &roi, cv::Mat &out);
+
+  // message of the last failure
+  const std::string &Error() const { return _error; }
+
+  // whether altego was built with libjpeg-turbo, every decode fails otherwise
+  static bool Available();
+
+  // libjpeg state, opaque outside jpeg.cpp
+  struct State;
+
+private:
+  std::unique_ptr<State> _state;
+  std::string _error;
+};
+} // namespace altego
+
+#endif // __ALTEGO_JPEG_H__
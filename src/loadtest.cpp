@@ -0,0 +1,249 @@
+/**
+ * loadtest.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "result.h"
+#include "server.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <dlib/cmd_line_parser.h>
+#include <functional>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace altego;
+
+// client side statistics of one connection
+struct ClientStats {
+  bool slow = false;
+  bool connected = false;
+  uint64_t received = 0;
+  uint64_t missed = 0;
+  std::vector<double> latencies;
+};
+
+static int64_t _nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double _cpuSeconds(const struct rusage &ru) {
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static double _percentile(std::vector<double> &v, double p) {
+  if (v.empty())
+    return 0;
+  return v[static_cast<size_t>(p * (v.size() - 1))];
+}
+
+// parse "r1:<seq>;r2:<publish time>;", returns false for other lines
+static bool _parseLine(const std::string &line, uint64_t &seq, int64_t &published) {
+  double r1 = 0, r2 = 0;
+  if (sscanf(line.c_str(), "r1:%lf;r2:%lf;", &r1, &r2) != 2)
+    return false;
+  seq = static_cast<uint64_t>(r1);
+  published = static_cast<int64_t>(r2);
+  return true;
+}
+
+static void _runClient(int port, const std::string &subscribe, int slowDelay, int64_t deadline, ClientStats &stats) {
+  int fd = -1;
+  // the server may still be starting
+  while (_nowMicros() < deadline) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+      break;
+    close(fd);
+    fd = -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  if (fd < 0)
+    return;
+  stats.connected = true;
+  timeval tv = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  if (!subscribe.empty()) {
+    std::string line = subscribe + "\n";
+    if (send(fd, line.data(), line.size(), 0) < 0) {
+      close(fd);
+      return;
+    }
+  }
+
+  std::string pending;
+  char buf[4096];
+  uint64_t first = 0, last = 0;
+  while (_nowMicros() < deadline) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n == 0)
+      break;
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        continue;
+      break;
+    }
+    int64_t now = _nowMicros();
+    pending.append(buf, static_cast<size_t>(n));
+    size_t pos;
+    while ((pos = pending.find('\n')) != std::string::npos) {
+      uint64_t seq;
+      int64_t published;
+      // keyframes resend the last update, only distinct updates are counted
+      if (_parseLine(pending.substr(0, pos), seq, published) && (first == 0 || seq > last)) {
+        if (first == 0)
+          first = seq;
+        last = seq;
+        stats.received++;
+        stats.latencies.push_back((now - published) / 1000.0);
+      }
+      pending.erase(0, pos + 1);
+    }
+    // a slow consumer lets the socket buffers fill up
+    if (slowDelay > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(slowDelay));
+  }
+  close(fd);
+  if (stats.received > 0)
+    stats.missed = (last - first + 1) - stats.received;
+}
+
+static void _report(const char *label, std::vector<ClientStats> &stats, bool slow) {
+  std::vector<double> latencies;
+  uint64_t clients = 0, connected = 0, received = 0, missed = 0;
+  for (auto &s : stats) {
+    if (s.slow != slow)
+      continue;
+    clients++;
+    connected += s.connected ? 1 : 0;
+    received += s.received;
+    missed += s.missed;
+    latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+  }
+  if (clients == 0)
+    return;
+  std::sort(latencies.begin(), latencies.end());
+  printf("%-6s clients %4llu connected %4llu received %8llu missed %8llu latency ms p50 %7.3f p90 %7.3f p99 %7.3f max %7.3f\n", label,
+         static_cast<unsigned long long>(clients), static_cast<unsigned long long>(connected), static_cast<unsigned long long>(received),
+         static_cast<unsigned long long>(missed), _percentile(latencies, 0.5), _percentile(latencies, 0.9), _percentile(latencies, 0.99),
+         latencies.empty() ? 0 : latencies.back());
+}
+
+// drive altego::Server from a synthetic producer and measure delivery to many local clients
+int main(int argc, char **argv) {
+  dlib::command_line_parser parser;
+  parser.add_option("h", "Display this help message.");
+  parser.add_option("port", "Port to listen on (default 16699).", 1);
+  parser.add_option("rate", "Results published per second (default 30).", 1);
+  parser.add_option("seconds", "Duration of the test (default 10).", 1);
+  parser.add_option("clients", "Number of client connections (default 200).", 1);
+  parser.add_option("slow", "Number of those clients that read slowly (default 10).", 1);
+  parser.add_option("slow-delay", "Milliseconds a slow client sleeps after each read (default 200).", 1);
+  parser.add_option("subscribe", "Subscription line sent by every client, e.g. \"rate:10;\".", 1);
+  try {
+    parser.parse(argc, argv);
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (parser.option("h")) {
+    std::cout << "Usage: altego-loadtest [options]" << std::endl;
+    parser.print_options();
+    return EXIT_SUCCESS;
+  }
+  auto port = dlib::get_option(parser, "port", 16699);
+  auto rate = dlib::get_option(parser, "rate", 30.0);
+  auto seconds = dlib::get_option(parser, "seconds", 10.0);
+  auto clients = dlib::get_option(parser, "clients", 200);
+  auto slow = dlib::get_option(parser, "slow", 10);
+  auto slowDelay = dlib::get_option(parser, "slow-delay", 200);
+  auto subscribe = dlib::get_option(parser, "subscribe", std::string());
+
+  // clients run in a child process forked before any thread exists, so server CPU can be measured on its own
+  int64_t start = _nowMicros();
+  pid_t child = fork();
+  if (child < 0) {
+    perror("fork");
+    return EXIT_FAILURE;
+  }
+  if (child == 0) {
+    int64_t deadline = start + static_cast<int64_t>((seconds + 2) * 1e6);
+    std::vector<ClientStats> stats(static_cast<size_t>(clients));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++) {
+      stats[i].slow = i < slow;
+      threads.emplace_back(_runClient, port, subscribe, stats[i].slow ? slowDelay : 0, deadline, std::ref(stats[i]));
+    }
+    for (auto &t : threads)
+      t.join();
+    _report("fast", stats, false);
+    _report("slow", stats, true);
+    _exit(EXIT_SUCCESS);
+  }
+
+  ResultStore store;
+  Server server;
+  server.set_listening_ip("127.0.0.1");
+  server.set_listening_port(static_cast<unsigned short>(port));
+  server.SetResultStore(&store);
+  server.start_async();
+
+  // synthetic producer, r1 carries the sequence and r2 the publish time in microseconds
+  struct rusage before = {}, after = {};
+  getrusage(RUSAGE_SELF, &before);
+  int64_t producerStart = _nowMicros();
+  auto interval = std::chrono::duration<double>(1.0 / rate);
+  auto next = std::chrono::steady_clock::now();
+  uint64_t published = 0;
+  while (_nowMicros() - start < seconds * 1e6) {
+    next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+    std::this_thread::sleep_until(next);
+    Result res;
+    res.r1 = static_cast<double>(++published);
+    res.r2 = static_cast<double>(_nowMicros());
+    store.Set(Update(res));
+  }
+  getrusage(RUSAGE_SELF, &after);
+  double wall = (_nowMicros() - producerStart) / 1e6;
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  printf("published %llu results at %.1f/s over %.1fs\n", static_cast<unsigned long long>(published), rate, wall);
+  printf("server cpu %.3fs, %.1f%% of one core\n", _cpuSeconds(after) - _cpuSeconds(before), 100.0 * (_cpuSeconds(after) - _cpuSeconds(before)) / wall);
+  server.clear();
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,13 +24,19 @@
  * SOFTWARE.
  */
 
-#include "algorithm.h"
-#include "capture.h"
+#include "frameexport.h"
+#include "journal.h"
+#include "pipeline.h"
+#include "placement.h"
+#include "predictor.h"
 #include "result.h"
 #include "server.h"
+#include "trace.h"
 #include "window.h"
 
+#include <dlib/cmd_line_parser.h>
 #include <fstream>
+#include <memory>
 #include <pwd.h>
 #include <thread>
 #include <unistd.h>
@@ -40,106 +46,254 @@ using namespace altego;
 static const double CAPTURE_WIDTHS[] = {1280, 800, 640};
 static const double CAPTURE_HEIGHTS[] = {720, 600, 360};
 
-class Application : public WindowDelegate, public CaptureDelegate {
+// frames in the shared memory ring, and bytes per frame, enough for 1080p BGR
+#define EXPORT_SLOTS 4
+#define EXPORT_SLOT_BYTES (1920 * 1080 * 3)
+
+class Application : public WindowDelegate, public PipelineDelegate {
 public:
-  Application() : _capture(), _window("AltEGO"), _device(0), _sizeIdx(0) {
+  Application() : _pipeline(), _window("AltEGO"), _device(0), _sizeIdx(0) {
     _window.SetDelegate(this);
-    _capture.SetDelegate(this);
-    _capture.SetDevice(_device);
-    _capture.SetSize(CAPTURE_WIDTHS[0], CAPTURE_HEIGHTS[0]);
+    _pipeline.SetDelegate(this);
+    _pipeline.SetDevice(_device);
+    _pipeline.SetSize(CAPTURE_WIDTHS[0], CAPTURE_HEIGHTS[0]);
     _server.set_listening_ip("127.0.0.1");
     _server.set_listening_port(6699);
-    _server.SetResultStore(&_resultStore);
+    _server.SetResultStore(_pipeline.GetResultStore());
+    _server.SetState(_pipeline.GetState());
+  }
+
+  void SetJournalDirectory(const std::string &dir) { _journal.reset(new Journal(dir)); }
+
+  void SetStaged(bool staged) { _pipeline.SetStaged(staged); }
+
+  void SetDetector(const std::string &spec) { _detectorSpec = spec; }
+
+  void SetModelFile(const std::string &modelFile) { _modelFile = modelFile; }
+
+  void SetFast(bool fast) { _fast = fast; }
+
+  void SetMJPEG(bool mjpeg) { _pipeline.SetMJPEG(mjpeg); }
+
+  void SetFile(const std::string &file) { _pipeline.SetFile(file); }
+
+  void SetPrediction(bool prediction) {
+    Predictor *predictor = prediction ? &_predictor : nullptr;
+    _pipeline.SetPredictor(predictor);
+    _server.SetPredictor(predictor);
+  }
+
+  void SetExport(const std::string &name, bool raw) {
+    _exportName = name;
+    _pipeline.SetAnnotate(!raw);
   }
 
   void Run() {
+    // accept clients right away, they are told the readiness until the first pose
+    _server.start_async();
     // determine model file
-    const char *home = nullptr;
-    if ((home = getenv("HOME")) == nullptr) {
-      home = getpwuid(getuid())->pw_dir;
+    std::string modelFile = _modelFile;
+    if (modelFile.empty()) {
+      const char *home = nullptr;
+      if ((home = getenv("HOME")) == nullptr) {
+        home = getpwuid(getuid())->pw_dir;
+      }
+      if (home == nullptr) {
+        _window.ShowErrorAndExit("Failed to determine $HOME directory");
+      }
+      modelFile = std::string(home) + (_fast ? "/.altego/shape_predictor_5_face_landmarks.dat" : "/.altego/shape_predictor_68_face_landmarks.dat");
     }
-    if (home == nullptr) {
-      _window.ShowErrorAndExit("Failed to determine $HOME directory");
+    // start journal
+    if (_journal != nullptr) {
+      try {
+        _journal->Start();
+      } catch (std::exception &err) {
+        _window.ShowErrorAndExit("Failed to start journal: " + std::string(err.what()));
+      }
     }
-    std::string modelFile = std::string(home) + "/.altego/shape_predictor_68_face_landmarks.dat";
-    // load model file
-    try {
-      _algorithm.LoadModelFile(modelFile);
-    } catch (std::exception &err) {
-      _window.ShowErrorAndExit("Failed to load model: " + std::string(err.what()));
+    // create frame export
+    if (!_exportName.empty()) {
+      try {
+        _frameExport.reset(new FrameExport(_exportName, EXPORT_SLOTS, EXPORT_SLOT_BYTES));
+      } catch (std::exception &err) {
+        _window.ShowErrorAndExit("Failed to create frame export: " + std::string(err.what()));
+      }
+      _pipeline.SetFrameExport(_frameExport.get());
     }
-    // start capture thread
-    std::thread captureThread(&Capture::Run, &_capture);
-    // start server async
-    _server.start_async();
+    // start capture thread, the camera opens while the model loads
+    _pipeline.Start();
+    std::thread loader(&Application::load, this, modelFile);
     // run the main loop
     _window.Run();
+    // deserialization cannot be interrupted
+    loader.join();
     // stop capture
-    _capture.Stop();
-    captureThread.join();
+    _pipeline.Stop();
+    // flush journal
+    if (_journal != nullptr)
+      _journal->Stop();
+    // write trace
+    Trace::Dump();
     // stop server
     //_server.clear();
     exit(EXIT_SUCCESS);
   }
 
+  // runs alongside camera open and the main loop, frames are resolved once the model is loaded
+  void load(const std::string &modelFile) {
+    Placement::Apply("loader");
+    // create face detector before the model, no frame reaches it until then
+    if (!_detectorSpec.empty()) {
+      try {
+        _pipeline.GetAlgorithm()->SetDetector(CreateDetector(_detectorSpec));
+      } catch (std::exception &err) {
+        _window.SetError("Failed to create detector: " + std::string(err.what()));
+        return;
+      }
+    }
+    // load model file
+    try {
+      _pipeline.LoadModelFile(modelFile);
+    } catch (std::exception &err) {
+      _window.SetError("Failed to load model: " + std::string(err.what()));
+    }
+  }
+
   void AltegoWindowKeyDown(Window *window, KeyType type) override {
     (void)window;
     switch (type) {
     case KeySizeUp:
       _sizeIdx++;
-      _capture.SetSize(CAPTURE_WIDTHS[_sizeIdx % 3], CAPTURE_HEIGHTS[_sizeIdx % 3]);
+      _pipeline.SetSize(CAPTURE_WIDTHS[_sizeIdx % 3], CAPTURE_HEIGHTS[_sizeIdx % 3]);
       break;
     case KeySizeDown:
       _sizeIdx--;
-      _capture.SetSize(CAPTURE_WIDTHS[_sizeIdx % 3], CAPTURE_HEIGHTS[_sizeIdx % 3]);
+      _pipeline.SetSize(CAPTURE_WIDTHS[_sizeIdx % 3], CAPTURE_HEIGHTS[_sizeIdx % 3]);
       break;
     case KeyCameraPrev:
       if (_device > 0) {
         _device--;
-        _capture.SetDevice(_device);
+        _pipeline.SetDevice(_device);
       }
       break;
     case KeyCameraNext:
       _device++;
-      _capture.SetDevice(_device);
+      _pipeline.SetDevice(_device);
       break;
     default:
       break;
     }
   }
 
-  void AltegoCaptureDeviceOpened(Capture *capture, int device) override {
-    (void)capture;
+  void AltegoPipelineDeviceOpened(Pipeline *pipeline, int device) override {
+    (void)pipeline;
     _window.SetDevice(device);
     _window.ClearImage();
   }
 
-  void AltegoCaptureFrameRead(Capture *capture, cv::Mat &im) override {
-    (void)capture;
-    // resolve and annotate camera frame
-    if (_algorithm.ResolveAndAnnotate(im, _result)) {
-      _resultStore.Set(_result);
-    }
+  void AltegoPipelineFrameResolved(Pipeline *pipeline, cv::Mat &im) override {
+    (void)pipeline;
     _window.SetImage(im);
   }
 
-  void AltegoCaptureFPSUpdated(Capture *capture, double fps) override {
-    (void)capture;
+  void AltegoPipelineResultUpdated(Pipeline *pipeline, const Result &res) override {
+    (void)pipeline;
+    if (_journal != nullptr)
+      _journal->Append(res);
+  }
+
+  void AltegoPipelineStateChanged(Pipeline *pipeline, StateType state) override {
+    (void)pipeline;
+    _server.SetState(state);
+    _window.SetState(state);
+    std::cout << "altego: " << StateName(state) << std::endl;
+  }
+
+  void AltegoPipelineFPSUpdated(Pipeline *pipeline, double fps) override {
+    (void)pipeline;
     _window.SetFPS(static_cast<int>(fps));
+    // report once every stage thread has processed frames, and again whenever threads such as server connections came or went
+    uint64_t generation = Placement::Generation();
+    if (generation != _placementGeneration) {
+      _placementGeneration = generation;
+      Placement::Report(std::cout);
+    }
   }
 
 private:
-  ResultStore _resultStore;
-  Result _result;
-  Capture _capture;
+  Pipeline _pipeline;
   Window _window;
-  Algorithm _algorithm;
   Server _server;
+  std::unique_ptr<Journal> _journal;
+  std::unique_ptr<FrameExport> _frameExport;
+  Predictor _predictor;
+  std::string _exportName;
+  std::string _detectorSpec;
+  std::string _modelFile;
+  bool _fast = false;
+  // placement generation last reported, touched by the capture thread only
+  uint64_t _placementGeneration = 0;
   int _device;
   int _sizeIdx;
 };
 
-int main() {
+int main(int argc, char **argv) {
+  dlib::command_line_parser parser;
+  parser.add_option("h", "Display this help message.");
+  parser.add_option("journal", "Append every result to a binary journal in directory <arg>.", 1);
+  parser.add_option("staged", "Run detection, landmarking and pose solving on separate threads.");
+  parser.add_option("trace", "Record per-frame spans and write Chrome trace JSON to <arg> on SIGUSR1 and at exit.", 1);
+  parser.add_option("model", "Shape predictor model file <arg>, 68 or 5 point (default ~/.altego/shape_predictor_68_face_landmarks.dat).", 1);
+  parser.add_option("fast", "Use the 5 point model ~/.altego/shape_predictor_5_face_landmarks.dat.");
+  parser.add_option("mjpeg", "Capture compressed MJPEG frames and decode the detection image at 1/4 scale.");
+  parser.add_option("video", "Read recorded frames from file <arg> instead of the camera, replayed when it ends.", 1);
+  parser.add_option("export", "Publish annotated frames into shared memory object <arg>, e.g. /altego-frames.", 1);
+  parser.add_option("export-raw", "With --export, publish frames without drawn landmarks, landmarks are still exported.");
+  parser.add_option("predict", "Fit a motion model to recent poses, so clients can subscribe to or query predicted poses.");
+  parser.add_option("thread", "Thread placement rule <arg>, e.g. \"role:capture;l2:2;fifo:50;\", may be given multiple times.", 1);
+  parser.add_option("detector", "Face detector <arg>: hog (default), yunet:<model.onnx>, cascade:<cascade.xml> or cascade+hog:<cascade.xml>.", 1);
+  try {
+    parser.parse(argc, argv);
+  } catch (std::exception &err) {
+    std::cerr << err.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (parser.option("h")) {
+    std::cout << "Usage: altego [options]" << std::endl;
+    parser.print_options();
+    return EXIT_SUCCESS;
+  }
+
+  // before any thread starts, each thread applies the rule of its role
+  for (unsigned long i = 0; i < parser.option("thread").count(); i++) {
+    try {
+      Placement::Configure(parser.option("thread").argument(0, i));
+    } catch (std::exception &err) {
+      std::cerr << "invalid --thread: " << err.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // before any other thread starts, so SIGUSR1 is blocked everywhere
+  if (parser.option("trace"))
+    Trace::Enable(parser.option("trace").argument());
+
   Application application;
+  if (parser.option("journal"))
+    application.SetJournalDirectory(parser.option("journal").argument());
+  application.SetStaged(parser.option("staged").count() > 0);
+  application.SetFast(parser.option("fast").count() > 0);
+  if (parser.option("model"))
+    application.SetModelFile(parser.option("model").argument());
+  if (parser.option("mjpeg") && !JpegDecoder::Available())
+    std::cerr << "altego: built without libjpeg-turbo, --mjpeg is ignored" << std::endl;
+  application.SetMJPEG(parser.option("mjpeg").count() > 0);
+  if (parser.option("video"))
+    application.SetFile(parser.option("video").argument());
+  application.SetPrediction(parser.option("predict").count() > 0);
+  if (parser.option("export"))
+    application.SetExport(parser.option("export").argument(), parser.option("export-raw").count() > 0);
+  if (parser.option("detector"))
+    application.SetDetector(parser.option("detector").argument());
   application.Run();
 }
@@ -0,0 +1,287 @@
+/**
+ * pipeline.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pipeline.h"
+#include "placement.h"
+#include "trace.h"
+
+// frames in flight in staged mode, one per stage plus one being filled by capture
+#define STAGED_FRAMES 4
+
+altego::Pipeline::Pipeline()
+    : _ready(false), _cameraOpened(false), _frames(STAGED_FRAMES), _free(STAGED_FRAMES), _detectQueue(STAGED_FRAMES), _landmarkQueue(STAGED_FRAMES),
+      _solveQueue(STAGED_FRAMES) {
+  _capture.SetDelegate(this);
+}
+
+altego::Pipeline::~Pipeline() { Stop(); }
+
+void altego::Pipeline::SetDelegate(altego::PipelineDelegate *delegate) { _delegate = delegate; }
+
+void altego::Pipeline::SetDevice(int device) { _capture.SetDevice(device); }
+
+void altego::Pipeline::SetSize(double width, double height) { _capture.SetSize(width, height); }
+
+// without libjpeg-turbo the capture keeps delivering frames decoded by OpenCV
+void altego::Pipeline::SetMJPEG(bool mjpeg) { _capture.SetMJPEG(mjpeg && JpegDecoder::Available()); }
+
+void altego::Pipeline::SetFile(const std::string &file) { _capture.SetFile(file); }
+
+void altego::Pipeline::SetPreview(bool preview) { _preview = preview; }
+
+void altego::Pipeline::SetAnnotate(bool annotate) {
+  _annotate = annotate;
+  _algorithm.SetAnnotate(annotate);
+}
+
+void altego::Pipeline::SetFrameExport(altego::FrameExport *frameExport) { _frameExport = frameExport; }
+
+void altego::Pipeline::SetPredictor(altego::Predictor *predictor) { _predictor = predictor; }
+
+void altego::Pipeline::SetEncoding(bool encoding) { _encoding = encoding; }
+
+void altego::Pipeline::LoadModelFile(const std::string &modelFile) {
+  _algorithm.LoadModelFile(modelFile);
+  // frames reach the algorithm from now on
+  _ready = true;
+  updateState();
+}
+
+altego::StateType altego::Pipeline::GetState() {
+  std::lock_guard<std::mutex> lock(_stateMutex);
+  return _state;
+}
+
+void altego::Pipeline::updateState() {
+  // serialized, so concurrent model load and device changes report the final state last
+  std::lock_guard<std::mutex> lock(_stateMutex);
+  StateType state = !_ready ? StateLoadingModel : !_cameraOpened ? StateWaitingCamera : StateTracking;
+  if (state == _state)
+    return;
+  _state = state;
+  if (_delegate != nullptr)
+    _delegate->AltegoPipelineStateChanged(this, state);
+}
+
+altego::ResultStore *altego::Pipeline::GetResultStore() { return &_resultStore; }
+
+altego::Algorithm *altego::Pipeline::GetAlgorithm() { return &_algorithm; }
+
+void altego::Pipeline::SetStaged(bool staged) { _staged = staged; }
+
+void altego::Pipeline::Start() {
+  if (_thread.joinable())
+    return;
+  if (_staged) {
+    _free.Reset();
+    _detectQueue.Reset();
+    _landmarkQueue.Reset();
+    _solveQueue.Reset();
+    for (auto &frame : _frames) {
+      Frame *f = &frame;
+      _free.TryPush(f);
+    }
+    _detectThread = std::thread(&Pipeline::runDetect, this);
+    _landmarkThread = std::thread(&Pipeline::runLandmark, this);
+    _solveThread = std::thread(&Pipeline::runSolve, this);
+  }
+  // cleared before the thread exists, so a Stop right after Start is never lost
+  _capture.Reset();
+  _thread = std::thread(&Capture::Run, &_capture);
+}
+
+void altego::Pipeline::Stop() {
+  if (!_thread.joinable())
+    return;
+  _capture.Stop();
+  _thread.join();
+  if (_detectThread.joinable()) {
+    // each stage closes the next one once drained
+    _detectQueue.Close();
+    _detectThread.join();
+    _landmarkThread.join();
+    _solveThread.join();
+  }
+}
+
+void altego::Pipeline::publish(altego::Frame &frame) {
+  TraceSpan span("publish", static_cast<int64_t>(frame.index));
+  // before the store wakes up server connections, frames without a new pose count as a still pose
+  if (_predictor != nullptr) {
+    if (frame.resolved)
+      _predictor->Observe(frame.result, frame.steady);
+    else
+      _predictor->Hold(frame.steady);
+  }
+  if (frame.resolved) {
+    Update update;
+    if (_encoding)
+      update = Update(frame.result);
+    else
+      update.result = frame.result;
+    update.frame = static_cast<int64_t>(frame.index);
+    _resultStore.Set(update);
+    if (_delegate != nullptr)
+      _delegate->AltegoPipelineResultUpdated(this, frame.result);
+  }
+  // a copy into shared memory, readers never hold up the pipeline
+  if (_frameExport != nullptr) {
+    TraceSpan exportSpan("export", static_cast<int64_t>(frame.index));
+    _frameExport->Write(frame, _annotate);
+  }
+  if (_delegate != nullptr)
+    _delegate->AltegoPipelineFrameResolved(this, frame.im);
+}
+
+void altego::Pipeline::runDetect() {
+  Placement::Apply("detect");
+  Frame *frame = nullptr;
+  while (_detectQueue.Pop(frame)) {
+    _algorithm.Detect(*frame);
+    // never blocks, the queue holds every frame
+    _landmarkQueue.TryPush(frame);
+  }
+  _landmarkQueue.Close();
+}
+
+void altego::Pipeline::runLandmark() {
+  Placement::Apply("landmark");
+  Frame *frame = nullptr;
+  while (_landmarkQueue.Pop(frame)) {
+    _algorithm.Landmark(*frame);
+    _solveQueue.TryPush(frame);
+  }
+  _solveQueue.Close();
+}
+
+void altego::Pipeline::runSolve() {
+  Placement::Apply("solve");
+  Frame *frame = nullptr;
+  while (_solveQueue.Pop(frame)) {
+    _algorithm.Solve(*frame);
+    // queues are FIFO, so frames are published in capture order
+    publish(*frame);
+    _free.TryPush(frame);
+  }
+}
+
+void altego::Pipeline::AltegoCaptureDeviceOpened(altego::Capture *capture, int device) {
+  (void)capture;
+  _cameraOpened = true;
+  updateState();
+  if (_delegate != nullptr)
+    _delegate->AltegoPipelineDeviceOpened(this, device);
+}
+
+void altego::Pipeline::AltegoCaptureDeviceClosed(altego::Capture *capture, int device) {
+  (void)capture;
+  (void)device;
+  _cameraOpened = false;
+  updateState();
+}
+
+altego::Frame *altego::Pipeline::acquire() {
+  // drop the frame if every buffer is still in flight, the stages would only fall further behind
+  Frame *frame = nullptr;
+  if (!_free.TryPop(frame)) {
+    TraceSpan span("capture.drop", static_cast<int64_t>(_frameIndex++));
+    return nullptr;
+  }
+  frame->index = _frameIndex++;
+  frame->timestamp = Predictor::Now();
+  frame->steady = Predictor::SteadyNow();
+  return frame;
+}
+
+void altego::Pipeline::process(altego::Frame &frame) {
+  _algorithm.Detect(frame);
+  _algorithm.Landmark(frame);
+  _algorithm.Solve(frame);
+  publish(frame);
+}
+
+void altego::Pipeline::AltegoCaptureFrameRead(altego::Capture *capture, cv::Mat &im) {
+  (void)capture;
+  // show the camera while the model is still loading
+  if (!_ready) {
+    if (_delegate != nullptr)
+      _delegate->AltegoPipelineFrameResolved(this, im);
+    return;
+  }
+  if (_staged) {
+    Frame *frame = acquire();
+    if (frame == nullptr)
+      return;
+    // copyTo reuses the frame buffer as long as frame size is unchanged
+    TraceSpan span("capture.copy", static_cast<int64_t>(frame->index));
+    frame->jpeg.clear();
+    im.copyTo(frame->im);
+    _detectQueue.TryPush(frame);
+    return;
+  }
+  // resolve and annotate camera frame
+  _frame.index = _frameIndex++;
+  _frame.timestamp = Predictor::Now();
+  _frame.steady = Predictor::SteadyNow();
+  _frame.jpeg.clear();
+  _frame.im = im;
+  process(_frame);
+  _frame.im.release();
+}
+
+void altego::Pipeline::AltegoCaptureJpegRead(altego::Capture *capture, const uint8_t *data, size_t size) {
+  (void)capture;
+  // show the camera while the model is still loading, decoded as the preview would be
+  if (!_ready) {
+    if (_delegate != nullptr && _preview && _loadingDecoder.Decode(data, size, 1, true, _loadingIm))
+      _delegate->AltegoPipelineFrameResolved(this, _loadingIm);
+    return;
+  }
+  if (_staged) {
+    Frame *frame = acquire();
+    if (frame == nullptr)
+      return;
+    // assign reuses the capacity of the frame buffer, decoding happens in the stages
+    TraceSpan span("capture.copy", static_cast<int64_t>(frame->index));
+    frame->jpeg.assign(data, data + size);
+    frame->preview = _preview;
+    _detectQueue.TryPush(frame);
+    return;
+  }
+  // decoded into the buffer of _frame, kept across frames
+  _frame.index = _frameIndex++;
+  _frame.timestamp = Predictor::Now();
+  _frame.steady = Predictor::SteadyNow();
+  _frame.jpeg.assign(data, data + size);
+  _frame.preview = _preview;
+  process(_frame);
+}
+
+void altego::Pipeline::AltegoCaptureFPSUpdated(altego::Capture *capture, double fps) {
+  (void)capture;
+  if (_delegate != nullptr)
+    _delegate->AltegoPipelineFPSUpdated(this, fps);
+}
@@ -0,0 +1,175 @@
+/**
+ * pipeline.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_PIPELINE_H__
+#define __ALTEGO_PIPELINE_H__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "algorithm.h"
+#include "capture.h"
+#include "frameexport.h"
+#include "predictor.h"
+#include "queue.h"
+#include "result.h"
+
+namespace altego {
+class Pipeline;
+
+class PipelineDelegate {
+public:
+  virtual void AltegoPipelineDeviceOpened(Pipeline *pipeline, int device) = 0;
+
+  virtual void AltegoPipelineFrameResolved(Pipeline *pipeline, cv::Mat &im) = 0;
+
+  virtual void AltegoPipelineResultUpdated(Pipeline *pipeline, const Result &res) = 0;
+
+  virtual void AltegoPipelineFPSUpdated(Pipeline *pipeline, double fps) = 0;
+
+  // called from the thread that caused the change
+  virtual void AltegoPipelineStateChanged(Pipeline *pipeline, StateType state) = 0;
+};
+
+/**
+ * Pipeline
+ *
+ * capture, resolve and publish to ResultStore, without any UI or network
+ */
+class Pipeline : public CaptureDelegate {
+public:
+  Pipeline();
+
+  ~Pipeline();
+
+  void SetDelegate(PipelineDelegate *delegate);
+
+  void SetDevice(int device);
+
+  void SetSize(double width, double height);
+
+  // capture compressed MJPEG frames and decode them in the algorithm stages, call while stopped
+  // ignored if altego was built without libjpeg-turbo
+  void SetMJPEG(bool mjpeg);
+
+  // read a recorded file instead of the camera device, call while stopped
+  void SetFile(const std::string &file);
+
+  // whether compressed frames are decoded in full for AltegoPipelineFrameResolved, otherwise only the face region is decoded
+  void SetPreview(bool preview);
+
+  // whether landmarks are drawn into frames, call while stopped
+  void SetAnnotate(bool annotate);
+
+  // also publish every frame into frameExport, nullptr to stop, call while stopped
+  void SetFrameExport(FrameExport *frameExport);
+
+  // also feed every frame into predictor, nullptr to stop, call while stopped
+  void SetPredictor(Predictor *predictor);
+
+  // whether published updates carry the wire encoding, only needed when a Server is attached
+  void SetEncoding(bool encoding);
+
+  // run detection, landmarking and solving on their own threads, call while stopped
+  void SetStaged(bool staged);
+
+  // load shape predictor, throws on failure, thread safe
+  // the first load may overlap Start, frames are only resolved once a model is loaded, later loads replace it while running
+  void LoadModelFile(const std::string &modelFile);
+
+  StateType GetState();
+
+  ResultStore *GetResultStore();
+
+  Algorithm *GetAlgorithm();
+
+  // start capture thread
+  void Start();
+
+  // stop and join capture thread
+  void Stop();
+
+  void AltegoCaptureDeviceOpened(Capture *capture, int device) override;
+
+  void AltegoCaptureDeviceClosed(Capture *capture, int device) override;
+
+  void AltegoCaptureFrameRead(Capture *capture, cv::Mat &im) override;
+
+  void AltegoCaptureJpegRead(Capture *capture, const uint8_t *data, size_t size) override;
+
+  void AltegoCaptureFPSUpdated(Capture *capture, double fps) override;
+
+private:
+  Capture _capture;
+  Algorithm _algorithm;
+  ResultStore _resultStore;
+  // frame for the sequential mode, shares the capture buffer
+  Frame _frame;
+  // compressed frames shown while the model is loading, capture thread only
+  JpegDecoder _loadingDecoder;
+  cv::Mat _loadingIm;
+  std::thread _thread;
+  uint64_t _frameIndex = 0;
+  bool _encoding = true;
+  bool _preview = true;
+  bool _annotate = true;
+  FrameExport *_frameExport = nullptr;
+  Predictor *_predictor = nullptr;
+  PipelineDelegate *_delegate = nullptr;
+
+  // readiness, _ready is set once a model is loaded and publishes it to the capture thread
+  std::atomic<bool> _ready;
+  std::atomic<bool> _cameraOpened;
+  std::mutex _stateMutex;
+  StateType _state = StateLoadingModel;
+
+  // staged mode, frames cycle from _free through the stage queues and back
+  bool _staged = false;
+  std::vector<Frame> _frames;
+  Queue<Frame *> _free, _detectQueue, _landmarkQueue, _solveQueue;
+  std::thread _detectThread, _landmarkThread, _solveThread;
+
+  // staged mode, a free frame or nullptr if every frame is in flight
+  Frame *acquire();
+
+  void process(Frame &frame);
+
+  void publish(Frame &frame);
+
+  void updateState();
+
+  void runDetect();
+
+  void runLandmark();
+
+  void runSolve();
+};
+} // namespace altego
+
+#endif // __ALTEGO_PIPELINE_H__
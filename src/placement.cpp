@@ -0,0 +1,280 @@
+/**
+ * placement.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "placement.h"
+#include "trace.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// thread names are limited to 15 characters by the kernel
+#define THREAD_NAME_MAX 15
+
+namespace {
+struct Rule {
+  bool hasCpus = false;
+  cpu_set_t cpus;
+  int fifo = 0;
+  bool hasNice = false;
+  int nice = 0;
+};
+
+struct Entry {
+  std::string role, name;
+  int tid;
+  // rule parts the kernel refused
+  std::string errors;
+};
+} // namespace
+
+static const char *ROLES[] = {"capture", "detect", "landmark", "solve", "server", "window", "journal", "loader"};
+
+static std::map<std::string, Rule> _rules;
+static std::mutex _entriesMutex;
+static std::vector<Entry> _entries;
+static uint64_t _generation = 0;
+
+static int _gettid() { return static_cast<int>(syscall(SYS_gettid)); }
+
+// unregisters the calling thread when it exits, so short-lived connection threads do not pile up
+struct EntryHolder {
+  int tid = 0;
+
+  ~EntryHolder() {
+    if (tid == 0)
+      return;
+    std::lock_guard<std::mutex> lock(_entriesMutex);
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+      if (it->tid == tid) {
+        _entries.erase(it);
+        _generation++;
+        break;
+      }
+    }
+  }
+};
+
+static thread_local EntryHolder _holder;
+
+// parse a kernel cpu list, "0,2-3"
+static bool _parseCpuList(const std::string &list, cpu_set_t &set) {
+  CPU_ZERO(&set);
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.empty() || item == "\n")
+      continue;
+    int first = 0, last = 0;
+    char dash = 0;
+    std::istringstream range(item);
+    if (!(range >> first))
+      return false;
+    last = first;
+    if (range >> dash && (dash != '-' || !(range >> last)))
+      return false;
+    if (first < 0 || last < first || last >= CPU_SETSIZE)
+      return false;
+    for (int cpu = first; cpu <= last; cpu++)
+      CPU_SET(cpu, &set);
+  }
+  return CPU_COUNT(&set) > 0;
+}
+
+static void _readCpuList(const std::string &path, cpu_set_t &set) {
+  std::ifstream in(path);
+  std::string list;
+  if (!std::getline(in, list) || !_parseCpuList(list, set))
+    throw std::invalid_argument("failed to read cpu list " + path);
+}
+
+static int _parseInt(const std::string &key, const std::string &value) {
+  try {
+    size_t pos = 0;
+    int n = std::stoi(value, &pos);
+    if (pos == value.size())
+      return n;
+  } catch (std::exception &) {
+  }
+  throw std::invalid_argument("invalid " + key + " value " + value);
+}
+
+// value of a "key: value" line of /proc/<pid>/task/<tid>/status
+static std::string _statusField(const std::string &status, const std::string &key) {
+  auto pos = status.find(key + ":");
+  if (pos == std::string::npos)
+    return "?";
+  pos = status.find_first_not_of(" \t", pos + key.size() + 1);
+  return status.substr(pos, status.find('\n', pos) - pos);
+}
+
+void altego::Placement::Configure(const std::string &spec) {
+  std::string role;
+  Rule rule;
+  std::istringstream in(spec);
+  std::string item;
+  while (std::getline(in, item, ';')) {
+    if (item.empty())
+      continue;
+    auto colon = item.find(':');
+    if (colon == std::string::npos)
+      throw std::invalid_argument("invalid placement item " + item);
+    auto key = item.substr(0, colon);
+    auto value = item.substr(colon + 1);
+    cpu_set_t set;
+    if (key == "role") {
+      role = value;
+      continue;
+    } else if (key == "cpus") {
+      if (!_parseCpuList(value, set))
+        throw std::invalid_argument("invalid cpu list " + value);
+    } else if (key == "node") {
+      _readCpuList("/sys/devices/system/node/node" + std::to_string(_parseInt(key, value)) + "/cpulist", set);
+    } else if (key == "l2") {
+      _readCpuList("/sys/devices/system/cpu/cpu" + std::to_string(_parseInt(key, value)) + "/cache/index2/shared_cpu_list", set);
+    } else if (key == "fifo") {
+      rule.fifo = _parseInt(key, value);
+      if (rule.fifo < sched_get_priority_min(SCHED_FIFO) || rule.fifo > sched_get_priority_max(SCHED_FIFO))
+        throw std::invalid_argument("fifo priority out of range " + value);
+      continue;
+    } else if (key == "nice") {
+      rule.nice = _parseInt(key, value);
+      rule.hasNice = true;
+      continue;
+    } else {
+      throw std::invalid_argument("unknown placement key " + key);
+    }
+    // cpu sets intersect
+    if (rule.hasCpus)
+      CPU_AND(&rule.cpus, &rule.cpus, &set);
+    else
+      rule.cpus = set;
+    rule.hasCpus = true;
+    if (CPU_COUNT(&rule.cpus) == 0)
+      throw std::invalid_argument("no cpu left for role " + role);
+  }
+  bool known = false;
+  for (auto r : ROLES)
+    known = known || role == r;
+  if (!known)
+    throw std::invalid_argument("unknown thread role " + role);
+  _rules[role] = rule;
+}
+
+void altego::Placement::Apply(const std::string &role, const std::string &name) {
+  Trace::SetThreadName(name);
+  Entry entry{role, name, _gettid(), ""};
+  // renaming the main thread would rename the process, the prefix is left out where it would truncate the name
+  if (entry.tid != getpid()) {
+    std::string threadName = "altego-" + name;
+    if (threadName.size() > THREAD_NAME_MAX)
+      threadName = name.substr(0, THREAD_NAME_MAX);
+    pthread_setname_np(pthread_self(), threadName.c_str());
+  }
+  auto it = _rules.find(role);
+  if (it != _rules.end()) {
+    const Rule &rule = it->second;
+    int err = 0;
+    if (rule.hasCpus && (err = pthread_setaffinity_np(pthread_self(), sizeof(rule.cpus), &rule.cpus)) != 0)
+      entry.errors += std::string(" cpus: ") + strerror(err);
+    if (rule.fifo > 0) {
+      sched_param param{};
+      param.sched_priority = rule.fifo;
+      if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0)
+        entry.errors += std::string(" fifo: ") + strerror(err);
+    }
+    // nice applies to the thread alone on Linux
+    if (rule.hasNice && setpriority(PRIO_PROCESS, static_cast<id_t>(entry.tid), rule.nice) != 0)
+      entry.errors += std::string(" nice: ") + strerror(errno);
+  }
+  std::lock_guard<std::mutex> lock(_entriesMutex);
+  // pooled threads apply again for every new job, their entry is replaced
+  if (_holder.tid == entry.tid) {
+    for (auto &e : _entries) {
+      if (e.tid == entry.tid)
+        e = entry;
+    }
+    _generation++;
+    return;
+  }
+  _holder.tid = entry.tid;
+  _entries.push_back(entry);
+  _generation++;
+}
+
+uint64_t altego::Placement::Generation() {
+  std::lock_guard<std::mutex> lock(_entriesMutex);
+  return _generation;
+}
+
+void altego::Placement::Report(std::ostream &out) {
+  std::lock_guard<std::mutex> lock(_entriesMutex);
+  for (auto it = _entries.begin(); it != _entries.end();) {
+    auto task = "/proc/self/task/" + std::to_string(it->tid);
+    std::ifstream statusFile(task + "/status");
+    // thread exited
+    if (!statusFile) {
+      it = _entries.erase(it);
+      continue;
+    }
+    std::stringstream status;
+    status << statusFile.rdbuf();
+    // processor is field 39 of stat, counted after the parenthesized command name
+    std::ifstream statFile(task + "/stat");
+    std::string stat((std::istreambuf_iterator<char>(statFile)), std::istreambuf_iterator<char>());
+    std::istringstream fields(stat.substr(stat.rfind(')') + 2));
+    std::string field, processor = "?";
+    for (int i = 3; fields >> field; i++) {
+      if (i == 39) {
+        processor = field;
+        break;
+      }
+    }
+    int policy = sched_getscheduler(it->tid);
+    sched_param param{};
+    sched_getparam(it->tid, &param);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(it->tid));
+    out << "placement: " << it->name << " (" << it->role << ") tid " << it->tid << " cpus " << _statusField(status.str(), "Cpus_allowed_list") << " "
+        << (policy == SCHED_FIFO ? "fifo " + std::to_string(param.sched_priority) : "other") << " nice " << (errno == 0 ? std::to_string(nice) : "?")
+        << " last cpu " << processor << " preempted " << _statusField(status.str(), "nonvoluntary_ctxt_switches");
+    if (!it->errors.empty())
+      out << " failed:" << it->errors;
+    out << std::endl;
+    ++it;
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * placement.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_PLACEMENT_H__
+#define __ALTEGO_PLACEMENT_H__
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace altego {
+/**
+ * Placement
+ *
+ * CPU affinity and scheduling per thread role, rules are configured before any thread starts and
+ * applied by each thread as it starts, roles are capture, detect, landmark, solve, server, window, journal and loader
+ */
+class Placement {
+public:
+  // add the rule of a role, "role:capture;cpus:2-3;fifo:50;", throws std::invalid_argument
+  // keys: cpus:<list> (e.g. 0,2-3), node:<n> (cpus of NUMA node n), l2:<cpu> (cpus sharing the L2 cache of cpu),
+  // fifo:<priority> (SCHED_FIFO), nice:<n>, cpu sets given by several keys are intersected
+  static void Configure(const std::string &spec);
+
+  // name the calling thread, apply the rule of role if any and register the thread for Report until it exits
+  // names should be short, the kernel keeps 15 characters, "altego-" included if it fits
+  static void Apply(const std::string &role, const std::string &name);
+
+  static void Apply(const std::string &role) { Apply(role, role); }
+
+  // achieved placement of every live registered thread, one line each
+  static void Report(std::ostream &out);
+
+  // changes whenever a thread registers or exits, to report again once the set of threads changed
+  static uint64_t Generation();
+};
+} // namespace altego
+
+#endif // __ALTEGO_PLACEMENT_H__
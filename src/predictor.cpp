@@ -0,0 +1,110 @@
+/**
+ * predictor.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "predictor.h"
+
+#include <algorithm>
+#include <chrono>
+
+// poses kept for fitting
+#define PREDICT_SAMPLES 16
+
+// only poses this recent relative to the latest one are fitted, in nanoseconds
+#define PREDICT_WINDOW 200000000LL
+
+// furthest extrapolation past the latest pose, in nanoseconds
+#define PREDICT_MAX_AHEAD 150000000LL
+
+altego::Predictor::Predictor() : _samples(PREDICT_SAMPLES) {}
+
+int64_t altego::Predictor::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t altego::Predictor::SteadyNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t altego::Predictor::ToSteady(int64_t wall) { return wall - Now() + SteadyNow(); }
+
+void altego::Predictor::add(const altego::Result &res, int64_t steady) {
+  // out of order poses would break the fit
+  if (_count > 0 && steady <= _samples[(_next + PREDICT_SAMPLES - 1) % PREDICT_SAMPLES].steady)
+    return;
+  _samples[_next] = Sample{res, steady};
+  _next = (_next + 1) % PREDICT_SAMPLES;
+  _count = std::min<size_t>(_count + 1, PREDICT_SAMPLES);
+}
+
+void altego::Predictor::Observe(const altego::Result &res, int64_t steady) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  add(res, steady);
+}
+
+void altego::Predictor::Hold(int64_t steady) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_count == 0)
+    return;
+  add(_samples[(_next + PREDICT_SAMPLES - 1) % PREDICT_SAMPLES].res, steady);
+}
+
+bool altego::Predictor::Predict(int64_t steady, altego::Result &res) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_count == 0)
+    return false;
+  const Sample &latest = _samples[(_next + PREDICT_SAMPLES - 1) % PREDICT_SAMPLES];
+  // least squares line per field over the window, times relative to the latest pose in seconds
+  double n = 0, st = 0, stt = 0, s1 = 0, st1 = 0, s2 = 0, st2 = 0;
+  int64_t oldest = latest.steady;
+  for (size_t i = 0; i < _count; i++) {
+    const Sample &sample = _samples[(_next + PREDICT_SAMPLES - 1 - i) % PREDICT_SAMPLES];
+    if (latest.steady - sample.steady > PREDICT_WINDOW)
+      break;
+    oldest = sample.steady;
+    double t = (sample.steady - latest.steady) / 1e9;
+    n += 1;
+    st += t;
+    stt += t * t;
+    s1 += sample.res.r1;
+    st1 += t * sample.res.r1;
+    s2 += sample.res.r2;
+    st2 += t * sample.res.r2;
+  }
+  res = latest.res;
+  res.timestamp = steady - SteadyNow() + Now();
+  double det = n * stt - st * st;
+  // a single pose, or poses too close together to fit a velocity
+  if (n < 2 || det <= 1e-12)
+    return true;
+  // the line only holds around the fitted poses
+  int64_t clamped = std::max<int64_t>(oldest, std::min<int64_t>(steady, latest.steady + PREDICT_MAX_AHEAD));
+  double t = (clamped - latest.steady) / 1e9;
+  double v1 = (n * st1 - st * s1) / det;
+  double v2 = (n * st2 - st * s2) / det;
+  res.r1 = (s1 - v1 * st) / n + v1 * t;
+  res.r2 = (s2 - v2 * st) / n + v2 * t;
+  return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * predictor.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_PREDICTOR_H__
+#define __ALTEGO_PREDICTOR_H__
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "result.h"
+
+namespace altego {
+/**
+ * Predictor
+ *
+ * constant velocity motion model fitted by least squares to the recent timestamped poses,
+ * fed by the pipeline and queried by server connections at their own rate,
+ * poses are fitted on the steady clock, only Result::timestamp is wall clock
+ */
+class Predictor {
+public:
+  Predictor();
+
+  // pose of a resolved frame captured at steady
+  void Observe(const Result &res, int64_t steady);
+
+  // pose unchanged at steady, for frames that published no new pose, decays the velocity
+  void Hold(int64_t steady);
+
+  // pose extrapolated to steady, clamped between the oldest fitted pose and PREDICT_MAX_AHEAD past the latest one,
+  // res.timestamp is steady in wall clock time, false before the first pose
+  bool Predict(int64_t steady, Result &res) const;
+
+  // wall clock nanoseconds since epoch, the clock of Result::timestamp
+  static int64_t Now();
+
+  // steady clock nanoseconds, the clock poses are fitted on
+  static int64_t SteadyNow();
+
+  // wall clock time to steady clock time, at the current offset between the clocks
+  static int64_t ToSteady(int64_t wall);
+
+private:
+  struct Sample {
+    Result res;
+    int64_t steady;
+  };
+
+  mutable std::mutex _mutex;
+  // ring of recent poses
+  std::vector<Sample> _samples;
+  size_t _next = 0, _count = 0;
+
+  void add(const Result &res, int64_t steady);
+};
+} // namespace altego
+
+#endif // __ALTEGO_PREDICTOR_H__
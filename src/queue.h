@@ -0,0 +1,110 @@
+/**
+ * queue.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_QUEUE_H__
+#define __ALTEGO_QUEUE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace altego {
+
+/**
+ * Queue
+ *
+ * bounded single-producer single-consumer queue, lock-free unless the consumer has to sleep
+ */
+template <class T> class Queue {
+public:
+  explicit Queue(size_t capacity) : _buf(capacity + 1), _head(0), _tail(0), _waiting(false), _closed(false) {}
+
+  // producer side, swaps v into the queue, returns false if full
+  bool TryPush(T &v) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % _buf.size();
+    if (next == _head.load(std::memory_order_acquire))
+      return false;
+    std::swap(_buf[tail], v);
+    _tail.store(next);
+    // wake consumer only if it is sleeping
+    if (_waiting.load()) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _cond.notify_one();
+    }
+    return true;
+  }
+
+  // consumer side, swaps the front item into v, returns false if empty
+  bool TryPop(T &v) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load())
+      return false;
+    std::swap(v, _buf[head]);
+    _head.store((head + 1) % _buf.size(), std::memory_order_release);
+    return true;
+  }
+
+  // consumer side, waits for an item, returns false once closed and drained
+  bool Pop(T &v) {
+    while (!TryPop(v)) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _waiting.store(true);
+      _cond.wait(lock, [this] { return _head.load(std::memory_order_relaxed) != _tail.load() || _closed; });
+      _waiting.store(false);
+      if (_closed && _head.load(std::memory_order_relaxed) == _tail.load())
+        return false;
+    }
+    return true;
+  }
+
+  // wake the consumer and make Pop return false once drained
+  void Close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _cond.notify_all();
+  }
+
+  // reopen after Close, only while neither side is running
+  void Reset() {
+    _head = 0;
+    _tail = 0;
+    _closed = false;
+  }
+
+private:
+  std::vector<T> _buf;
+  std::atomic<size_t> _head, _tail;
+  std::atomic<bool> _waiting;
+  bool _closed;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+};
+} // namespace altego
+
+#endif
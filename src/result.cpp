@@ -26,11 +26,29 @@
 
 #include "result.h"
 
-void altego::Result::Serialize(std::ostream &out) {
-#define _PUT(V) out << #V << ":" << std::to_string(V) << ";"
-  _PUT(r1);
-  _PUT(r2);
-  out << std::endl;
+const char *altego::StateName(altego::StateType state) {
+  switch (state) {
+  case StateLoadingModel:
+    return "loading_model";
+  case StateWaitingCamera:
+    return "waiting_camera";
+  case StateTracking:
+    return "tracking";
+  }
+  return "unknown";
+}
+
+void altego::Result::Serialize(std::ostream &out) { out << Encode() << std::flush; }
+
+std::string altego::Result::Encode(unsigned fields) const {
+  std::string s;
+#define _PUT(F, V) if (fields & (F)) s.append(#V ":").append(std::to_string(V)).append(";")
+  _PUT(FieldR1, r1);
+  _PUT(FieldR2, r2);
+  _PUT(FieldTimestamp, timestamp);
+#undef _PUT
+  s.push_back('\n');
+  return s;
 }
 
 double altego::Result::Diff(altego::Result &rhs) {
@@ -28,6 +28,8 @@
 #define __ALTEGO_RESULT_H__
 
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include <dlib/threads.h>
 #include <opencv2/core.hpp>
@@ -35,21 +37,59 @@
 #include "store.h"
 
 namespace altego {
+
+typedef enum {
+  FieldR1 = 1 << 0,
+  FieldR2 = 1 << 1,
+  FieldAll = FieldR1 | FieldR2,
+  // opt-in, not part of FieldAll
+  FieldTimestamp = 1 << 2,
+} FieldType;
+
+// readiness of the pipeline, reported to clients subscribing with state:1
+typedef enum {
+  StateLoadingModel,
+  StateWaitingCamera,
+  StateTracking,
+} StateType;
+
+// wire name of a state
+const char *StateName(StateType state);
+
 class Result {
 public:
   // rotation vector
   double r1 = 0;
   double r2 = 0;
+  // capture time of the frame, or the time a predicted pose is for, wall clock nanoseconds since epoch
+  int64_t timestamp = 0;
 
   // serialize result to stream
   void Serialize(std::ostream &out);
 
+  // encode result to its wire format, one line terminated by '\n'
+  // fields is a mask of FieldType
+  std::string Encode(unsigned fields = FieldAll) const;
+
   // difference against another result
   double Diff(Result &rhs);
 };
 
+// a published result with its wire encoding, encoded once and shared by all connections
+class Update {
+public:
+  Update() = default;
+
+  explicit Update(const Result &r) : result(r), encoded(std::make_shared<std::string>(r.Encode())) {}
+
+  Result result;
+  std::shared_ptr<const std::string> encoded;
+  // index of the frame the result was resolved from, for tracing, -1 if not tied to a frame
+  int64_t frame = -1;
+};
+
 // ResultStore with wait and broadcast
-using ResultStore = Store<Result>;
+using ResultStore = Store<Update>;
 
 } // namespace altego
 
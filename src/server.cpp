@@ -25,21 +25,147 @@
  */
 
 #include "server.h"
+#include "placement.h"
+#include "subscription.h"
+#include "trace.h"
 
-altego::Server::Server() : dlib::server_iostream() { set_graceful_close_timeout(1000); }
+#include <chrono>
+#include <dlib/sockstreambuf.h>
+#include <mutex>
+#include <thread>
+
+// interval to wake up and check keyframes and connection state, in milliseconds
+#define POLL_INTERVAL 100
+
+// without a pipeline reporting readiness, results are assumed to flow
+altego::Server::Server() : dlib::server(), _state(StateTracking), _connections(0) { set_graceful_close_timeout(1000); }
 
 void altego::Server::SetResultStore(altego::ResultStore *resultStore) { _resultStore = resultStore; }
 
-void altego::Server::on_connect(std::istream &in, std::ostream &out, const std::string &foreign_ip, const std::string &local_ip, unsigned short foreign_port,
-                                unsigned short local_port, dlib::uint64 connection_id) {
-  (void)in;
-  (void)foreign_ip;
-  (void)local_ip;
-  (void)foreign_port;
-  (void)local_port;
+void altego::Server::SetState(altego::StateType state) { _state = state; }
+
+void altego::Server::SetPredictor(altego::Predictor *predictor) { _predictor = predictor; }
+
+void altego::Server::on_connect(dlib::connection &con) {
+  if (_resultStore == nullptr)
+    return;
+  uint64_t connection_id = ++_connections;
   std::cout << "server: new connection [" << connection_id << "]" << std::endl;
-  while (_resultStore != nullptr && out.good()) {
-    _resultStore->Next().Serialize(out);
+  Placement::Apply("server", "srv-" + std::to_string(connection_id));
+
+  // one stream buffer per direction, the reader thread and this one never share stream state
+  // (a single sockstreambuf is not thread safe), only the connection, whose read and write may run concurrently
+  dlib::sockstreambuf inBuf(&con), outBuf(&con);
+  std::istream in(&inBuf);
+  std::ostream out(&outBuf);
+
+  // subscription, renegotiable at any time by sending another request line
+  Subscription subscription;
+  std::mutex subscriptionMutex;
+  // queries are answered by the reader, so every access to out, including its state, is serialized
+  std::mutex writeMutex;
+  auto writable = [&] {
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    return out.good();
+  };
+  std::thread reader([&] {
+    Placement::Apply("server", "srv-r-" + std::to_string(connection_id));
+    std::string line;
+    while (std::getline(in, line)) {
+      std::lock_guard<std::mutex> lock(subscriptionMutex);
+      Subscription next = subscription;
+      if (!next.Parse(line))
+        continue;
+      if (next.query) {
+        next.query = false;
+        // pose at the requested time, or the latest one without a predictor
+        Result res;
+        if (_predictor == nullptr || !_predictor->Predict(next.at == 0 ? Predictor::SteadyNow() : Predictor::ToSteady(next.at), res))
+          res = _resultStore->Get().result;
+        std::lock_guard<std::mutex> writeLock(writeMutex);
+        out << res.Encode(next.fields | FieldTimestamp);
+        out.flush();
+      } else {
+        std::cout << "server: connection [" << connection_id << "] subscribed: " << line << std::endl;
+      }
+      subscription = next;
+    }
+  });
+
+  // sequence of the last update seen by this connection
+  uint64_t seq = 0;
+  // last update written to this connection
+  Update last;
+  std::chrono::steady_clock::time_point lastSent;
+  // last state sent, -1 for none
+  int lastState = -1;
+  // last prediction in paced mode, paced even while the dead-band holds sends back
+  std::chrono::steady_clock::time_point lastPredicted;
+  while (writable()) {
+    Subscription sub;
+    {
+      std::lock_guard<std::mutex> lock(subscriptionMutex);
+      sub = subscription;
+    }
+    // readiness, checked at least every POLL_INTERVAL while waiting for updates
+    int state = _state;
+    if (sub.state && state != lastState) {
+      std::lock_guard<std::mutex> writeLock(writeMutex);
+      out << "state:" << StateName(static_cast<StateType>(state)) << ";\n";
+      out.flush();
+      lastState = state;
+    }
+    // rate limit, updates arriving while sleeping are coalesced into the latest one
+    if (sub.rate > 0 && last.encoded != nullptr) {
+      auto slot = lastSent + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / sub.rate));
+      std::this_thread::sleep_until(slot);
+    }
+    bool predicting = _predictor != nullptr && sub.predict >= 0;
+    Update update;
+    bool fresh = true;
+    Result predicted;
+    if (predicting && sub.rate > 0) {
+      // paced by the client's rate rather than by camera updates
+      auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / sub.rate));
+      std::this_thread::sleep_until(lastPredicted + period);
+      lastPredicted = std::chrono::steady_clock::now();
+      if (!_predictor->Predict(Predictor::SteadyNow() + sub.predict * 1000000, predicted)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL));
+        continue;
+      }
+      update = Update(predicted);
+    } else {
+      fresh = _resultStore->Next(seq, update, POLL_INTERVAL);
+      if (update.encoded == nullptr)
+        continue;
+      // camera updates shifted forward by the requested lead, keyframes too, so they never send the stored camera pose
+      if (predicting && _predictor->Predict(Predictor::SteadyNow() + sub.predict * 1000000, predicted)) {
+        int64_t frame = update.frame;
+        update = Update(predicted);
+        update.frame = frame;
+      }
+    }
+    auto now = std::chrono::steady_clock::now();
+    bool keyframe = sub.keyframe > 0 && last.encoded != nullptr && now - lastSent >= std::chrono::milliseconds(sub.keyframe);
+    if (!fresh && !keyframe)
+      continue;
+    // dead-band against the last sent result
+    if (!keyframe && sub.threshold > 0 && last.encoded != nullptr && update.result.Diff(last.result) < sub.threshold)
+      continue;
+    TraceSpan span("server.write", update.frame);
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    if (sub.fields == FieldAll) {
+      // the buffer is shared with every other connection, write it as is with a single flush
+      out.write(update.encoded->data(), static_cast<std::streamsize>(update.encoded->size()));
+    } else {
+      out << update.result.Encode(sub.fields);
+    }
+    out.flush();
+    last = update;
+    lastSent = now;
   }
+
+  // reader ends once the peer has gone away
+  reader.join();
   std::cout << "server: connection [" << connection_id << "] closed" << std::endl;
 }
@@ -27,22 +27,37 @@
 #ifndef __ALTEGO_SERVER_H__
 #define __ALTEGO_SERVER_H__
 
+#include <atomic>
 #include <dlib/server.h>
 
+#include "predictor.h"
 #include "result.h"
 
 namespace altego {
-class Server : public dlib::server_iostream {
+/**
+ * Server
+ *
+ * sends published results to every connection, with per-connection subscriptions
+ */
+class Server : public dlib::server {
 public:
   Server();
 
   void SetResultStore(ResultStore *resultStore);
 
-  void on_connect(std::istream &in, std::ostream &out, const std::string &foreign_ip, const std::string &local_ip, unsigned short foreign_port,
-                  unsigned short local_port, dlib::uint64 connection_id) override;
+  // enables the predict and at subscription options, call before start
+  void SetPredictor(Predictor *predictor);
+
+  // readiness sent to clients subscribing with state:1, may be called from any thread
+  void SetState(StateType state);
+
+  void on_connect(dlib::connection &con) override;
 
 private:
   ResultStore *_resultStore = nullptr;
+  Predictor *_predictor = nullptr;
+  std::atomic<int> _state;
+  std::atomic<uint64_t> _connections;
 };
 } // namespace altego
 
@@ -27,6 +27,7 @@
 #ifndef __ALTEGO_STORE_H__
 #define __ALTEGO_STORE_H__
 
+#include <cstdint>
 #include <dlib/threads.h>
 
 namespace altego {
@@ -43,20 +44,56 @@ public:
     delete _mutex;
   }
 
+  // wait for the next value set after this call
   T Next() {
-    _signaler->wait();
-    return Get();
+    uint64_t seq = Seq();
+    return Next(seq);
   }
 
-  T Get() { return _v; }
+  // wait for a value newer than seq, seq is updated to the returned value's sequence
+  // intermediate values are skipped, so a slow reader always gets the latest one
+  T Next(uint64_t &seq) {
+    dlib::auto_mutex lock(*_mutex);
+    while (_seq == seq)
+      _signaler->wait();
+    seq = _seq;
+    return _v;
+  }
+
+  // like Next(seq) but gives up after timeout milliseconds, 0 does not wait at all
+  // v is always set to the latest value, returns true if it is newer than seq
+  bool Next(uint64_t &seq, T &v, unsigned long timeout) {
+    dlib::auto_mutex lock(*_mutex);
+    if (_seq == seq && timeout > 0)
+      _signaler->wait_or_timeout(timeout);
+    v = _v;
+    if (_seq == seq)
+      return false;
+    seq = _seq;
+    return true;
+  }
+
+  T Get() {
+    dlib::auto_mutex lock(*_mutex);
+    return _v;
+  }
+
+  // sequence of the current value, 0 if nothing was set yet
+  uint64_t Seq() {
+    dlib::auto_mutex lock(*_mutex);
+    return _seq;
+  }
 
   void Set(const T &v) {
+    dlib::auto_mutex lock(*_mutex);
     _v = v;
+    _seq++;
     _signaler->broadcast();
   }
 
 private:
   T _v;
+  uint64_t _seq = 0;
   dlib::mutex *_mutex;
   dlib::signaler *_signaler;
 };
@@ -0,0 +1,85 @@
+/**
+ * subscription.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "subscription.h"
+
+#include <algorithm>
+#include <sstream>
+
+unsigned _parseFields(const std::string &value) {
+  unsigned fields = 0;
+  std::istringstream in(value);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    if (name == "r1")
+      fields |= altego::FieldR1;
+    else if (name == "r2")
+      fields |= altego::FieldR2;
+    else if (name == "timestamp")
+      fields |= altego::FieldTimestamp;
+  }
+  return fields;
+}
+
+bool altego::Subscription::Parse(const std::string &line) {
+  bool valid = false;
+  std::istringstream in(line);
+  std::string pair;
+  while (std::getline(in, pair, ';')) {
+    auto pos = pair.find(':');
+    if (pos == std::string::npos)
+      continue;
+    std::string key = pair.substr(0, pos);
+    std::string value = pair.substr(pos + 1);
+    try {
+      if (key == "rate") {
+        rate = std::max(0.0, std::stod(value));
+      } else if (key == "threshold") {
+        threshold = std::max(0.0, std::stod(value));
+      } else if (key == "keyframe") {
+        keyframe = std::max(0L, std::stol(value));
+      } else if (key == "state") {
+        state = std::stol(value) != 0;
+      } else if (key == "predict") {
+        predict = std::max(-1L, std::stol(value));
+      } else if (key == "at") {
+        at = value == "now" ? 0 : std::stoll(value);
+        query = true;
+      } else if (key == "fields") {
+        unsigned f = _parseFields(value);
+        if (f == 0)
+          continue;
+        fields = f;
+      } else {
+        continue;
+      }
+      valid = true;
+    } catch (std::exception &) {
+      // ignore malformed value
+    }
+  }
+  return valid;
+}
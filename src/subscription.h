@@ -0,0 +1,71 @@
+/**
+ * subscription.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_SUBSCRIPTION_H__
+#define __ALTEGO_SUBSCRIPTION_H__
+
+#include <cstdint>
+#include <string>
+
+#include "result.h"
+
+namespace altego {
+/**
+ * Subscription
+ *
+ * per-connection delivery options, negotiated by the client with a request line
+ * in the same "key:value;" format as results, e.g.
+ *
+ *   rate:30;threshold:0.05;keyframe:1000;fields:r1,r2;
+ *   rate:120;predict:10;fields:r1,r2,timestamp;
+ *
+ * clients that never send a request get every update at full rate
+ */
+class Subscription {
+public:
+  // maximum updates per second, 0 for unlimited
+  double rate = 0;
+  // minimum Result::Diff against the last sent result, 0 sends every update
+  double threshold = 0;
+  // resend the latest result after this many milliseconds without a send, 0 disables
+  long keyframe = 0;
+  // mask of FieldType to send
+  unsigned fields = FieldAll;
+  // also send a "state:<name>;" line on subscribing and on every change of readiness
+  bool state = false;
+  // send poses predicted this many milliseconds past now, -1 disables, needs a Predictor
+  // with rate > 0 predicted poses are sent at rate rather than once per camera update
+  long predict = -1;
+  // one-shot query "at:<ns>" or "at:now", answered with the pose at that wall clock time, 0 for now
+  bool query = false;
+  int64_t at = 0;
+
+  // parse a request line, returns false if it contains no valid option
+  bool Parse(const std::string &line);
+};
+} // namespace altego
+
+#endif
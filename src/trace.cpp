@@ -0,0 +1,198 @@
+/**
+ * trace.cpp
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "trace.h"
+
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Span {
+  const char *name;
+  int64_t begin, end, arg;
+};
+
+struct Buffer {
+  std::mutex mutex;
+  std::vector<Span> spans;
+  size_t next = 0;
+  bool wrapped = false;
+  int tid = 0;
+  std::string name;
+};
+} // namespace
+
+std::atomic<bool> altego::Trace::_enabled(false);
+
+static std::string _file;
+static size_t _capacity = 0;
+static std::mutex _buffersMutex;
+// serializes whole dumps, the signal thread and an exit path may dump at once
+static std::mutex _dumpMutex;
+// buffers outlive their threads, so spans of exited threads still get dumped until the buffer is reused
+static std::vector<Buffer *> _buffers;
+// buffers of exited threads, reused by new threads, so the number of buffers is bounded by the number of live threads
+static std::vector<Buffer *> _freeBuffers;
+static int _nextTid = 0;
+
+// returns the buffer of the calling thread to _freeBuffers when the thread exits
+struct BufferHolder {
+  Buffer *buffer = nullptr;
+
+  ~BufferHolder() {
+    if (buffer == nullptr)
+      return;
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    _freeBuffers.push_back(buffer);
+  }
+};
+
+static thread_local BufferHolder _holder;
+
+static Buffer *_threadBuffer() {
+  if (_holder.buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    Buffer *buffer = nullptr;
+    if (!_freeBuffers.empty()) {
+      buffer = _freeBuffers.back();
+      _freeBuffers.pop_back();
+    } else {
+      buffer = new Buffer();
+      buffer->spans.resize(_capacity);
+      _buffers.push_back(buffer);
+    }
+    // a new tid, spans of the previous owner are dropped
+    std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+    buffer->next = 0;
+    buffer->wrapped = false;
+    buffer->name.clear();
+    buffer->tid = ++_nextTid;
+    _holder.buffer = buffer;
+  }
+  return _holder.buffer;
+}
+
+static std::string _escape(const std::string &s) {
+  std::string out;
+  for (auto c : s) {
+    if (c == '"' || c == '\\')
+      out.push_back('\\');
+    out.push_back(c);
+  }
+  return out;
+}
+
+void altego::Trace::Enable(const std::string &file, size_t spans) {
+  _file = file;
+  _capacity = spans;
+  // SIGUSR1, SIGINT and SIGTERM are blocked here and in every thread started afterwards, and handled by a dedicated thread
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &set, nullptr);
+  std::thread([set] {
+    for (;;) {
+      int sig = 0;
+      if (sigwait(&set, &sig) != 0)
+        continue;
+      Dump();
+      if (sig == SIGUSR1)
+        continue;
+      // terminate as the signal would have without tracing
+      sigset_t one;
+      sigemptyset(&one);
+      sigaddset(&one, sig);
+      signal(sig, SIG_DFL);
+      pthread_sigmask(SIG_UNBLOCK, &one, nullptr);
+      raise(sig);
+    }
+  }).detach();
+  _enabled = true;
+}
+
+void altego::Trace::SetThreadName(const std::string &name) {
+  if (!Enabled())
+    return;
+  Buffer *buffer = _threadBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->name = name;
+}
+
+void altego::Trace::Record(const char *name, int64_t begin, int64_t end, int64_t arg) {
+  Buffer *buffer = _threadBuffer();
+  // only contended while dumping
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->spans[buffer->next] = Span{name, begin, end, arg};
+  if (++buffer->next == buffer->spans.size()) {
+    buffer->next = 0;
+    buffer->wrapped = true;
+  }
+}
+
+void altego::Trace::Dump() {
+  if (!Enabled())
+    return;
+  std::lock_guard<std::mutex> dumpLock(_dumpMutex);
+  std::ofstream out(_file);
+  if (!out) {
+    std::cerr << "trace: failed to open " << _file << std::endl;
+    return;
+  }
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  std::lock_guard<std::mutex> buffersLock(_buffersMutex);
+  for (auto buffer : _buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (!buffer->name.empty()) {
+      out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":\""
+          << _escape(buffer->name) << "\"}}";
+      first = false;
+    }
+    // oldest first
+    size_t count = buffer->wrapped ? buffer->spans.size() : buffer->next;
+    size_t start = buffer->wrapped ? buffer->next : 0;
+    for (size_t i = 0; i < count; i++) {
+      const Span &span = buffer->spans[(start + i) % buffer->spans.size()];
+      out << (first ? "" : ",") << "\n{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << span.begin / 1000.0
+          << ",\"dur\":" << (span.end - span.begin) / 1000.0;
+      if (span.arg >= 0)
+        out << ",\"args\":{\"frame\":" << span.arg << "}";
+      out << "}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+  std::cout << "trace: written to " << _file << std::endl;
+}
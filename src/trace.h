@@ -0,0 +1,90 @@
+/**
+ * trace.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2018 LandZERO
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __ALTEGO_TRACE_H__
+#define __ALTEGO_TRACE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace altego {
+/**
+ * Trace
+ *
+ * opt-in span tracer, spans are recorded into a ring buffer per thread and dumped as
+ * Chrome trace event JSON (chrome://tracing, ui.perfetto.dev) on SIGUSR1, SIGINT, SIGTERM or by Dump
+ */
+class Trace {
+public:
+  // enable tracing to file, keeping the last spans spans per thread, call before starting other threads
+  static void Enable(const std::string &file, size_t spans = 65536);
+
+  static bool Enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+  // name the calling thread in the trace
+  static void SetThreadName(const std::string &name);
+
+  // record a finished span, times are steady clock nanoseconds, arg < 0 for none
+  static void Record(const char *name, int64_t begin, int64_t end, int64_t arg);
+
+  // write all recorded spans to the trace file
+  static void Dump();
+
+  static int64_t Now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+private:
+  static std::atomic<bool> _enabled;
+};
+
+/**
+ * TraceSpan
+ *
+ * records the lifetime of the object as a span, costs a relaxed load when tracing is disabled
+ */
+class TraceSpan {
+public:
+  // name must be a string literal, arg is typically the frame index
+  explicit TraceSpan(const char *name, int64_t arg = -1) : _name(name), _arg(arg), _begin(Trace::Enabled() ? Trace::Now() : 0) {}
+
+  ~TraceSpan() {
+    if (_begin != 0)
+      Trace::Record(_name, _begin, Trace::Now(), _arg);
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *_name;
+  int64_t _arg;
+  int64_t _begin;
+};
+} // namespace altego
+
+#endif // __ALTEGO_TRACE_H__
@@ -25,6 +25,8 @@
  */
 
 #include "window.h"
+#include "placement.h"
+#include "trace.h"
 
 #include <opencv2/opencv.hpp>
 
@@ -53,10 +55,13 @@ void altego::Window::SetDelegate(altego::WindowDelegate *delegate) { _delegate =
 void altego::Window::ClearImage() { SetImage(_initialImage); }
 
 void altego::Window::SetImage(cv::Mat &im) {
+  TraceSpan span("window.set_image");
   std::lock_guard<std::mutex> lock(_imMutex);
+  // copyTo reuses the buffer of _im as long as frame size is unchanged
   im.copyTo(_im);
   _width = im.cols;
   _height = im.rows;
+  _fresh = true;
   _touched = true;
 }
 
@@ -67,19 +72,36 @@ void altego::Window::renderTitle(cv::Mat &im) {
 }
 
 void altego::Window::renderStatus(cv::Mat &im) {
+  StateType state;
+  {
+    std::lock_guard<std::mutex> lock(_imMutex);
+    state = _state;
+  }
   _width = im.cols;
   _height = im.rows;
   cv::rectangle(im, cv::Point(0, im.rows - _helpSize.height - 20), cv::Point(im.cols, im.rows), cv::Scalar(255, 99, 72), -1);
-  std::string s = "CAM: " + std::to_string(_device) + " | SIZE: " + std::to_string(_width) + "x" + std::to_string(_height) + " | FPS: " + std::to_string(_fps);
+  std::string s = "CAM: " + std::to_string(_device) + " | SIZE: " + std::to_string(_width) + "x" + std::to_string(_height) + " | FPS: " + std::to_string(_fps) +
+                  " | " + StateName(state);
   cv::putText(im, s, cv::Point(10, im.rows - 10), cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255, 255, 255));
 }
 
 void altego::Window::Run() {
+  Placement::Apply("window");
   cv::Mat im;
   for (;;) {
+    // errors raised on other threads
+    {
+      std::unique_lock<std::mutex> lock(_imMutex);
+      if (!_error.empty()) {
+        std::string error = _error;
+        lock.unlock();
+        ShowErrorAndExit(error);
+      }
+    }
     // re-render if needed
     if (_touched) {
-      copyImage(im);
+      TraceSpan span("window.render");
+      takeImage(im);
       renderTitle(im);
       renderStatus(im);
       cv::imshow(_title, im);
@@ -119,9 +141,15 @@ void altego::Window::Run() {
   }
 }
 
-void altego::Window::copyImage(cv::Mat &im) {
+void altego::Window::takeImage(cv::Mat &im) {
+  TraceSpan span("window.take_image");
   std::lock_guard<std::mutex> lock(_imMutex);
-  _im.copyTo(im);
+  // keep rendering the last taken image if nothing new arrived
+  if (!_fresh)
+    return;
+  // hand the previous render buffer back for the next SetImage to fill
+  cv::swap(_im, im);
+  _fresh = false;
 }
 
 void altego::Window::SetDevice(int device) {
@@ -140,6 +168,19 @@ void altego::Window::SetFPS(int fps) {
   _touched = true;
 }
 
+void altego::Window::SetState(altego::StateType state) {
+  {
+    std::lock_guard<std::mutex> lock(_imMutex);
+    _state = state;
+  }
+  _touched = true;
+}
+
+void altego::Window::SetError(const std::string &error) {
+  std::lock_guard<std::mutex> lock(_imMutex);
+  _error = error;
+}
+
 void altego::Window::ShowErrorAndExit(const std::string &error) {
   static const std::string hint = "Press ANY key to exit";
   cv::Size size = cv::getTextSize(error, cv::FONT_HERSHEY_SIMPLEX, 0.6, 1, nullptr);
@@ -148,6 +189,8 @@ void altego::Window::ShowErrorAndExit(const std::string &error) {
   cv::putText(im, error, cv::Point((im.cols - size.width) / 2, 20 + size.height / 2), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(255, 255, 255));
   cv::putText(im, hint, cv::Point((im.cols - size2.width) / 2, 40 + size.height + size2.height / 2), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(255, 255, 255));
   cv::imshow(_title, im);
+  // exit skips the dump at the end of Application::Run
+  Trace::Dump();
   cv::waitKey(0);
   exit(EXIT_FAILURE);
 }
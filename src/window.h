@@ -29,6 +29,9 @@
 
 #include <mutex>
 #include <opencv2/core.hpp>
+#include <string>
+
+#include "result.h"
 
 namespace altego {
 
@@ -70,8 +73,13 @@ public:
 
   void SetFPS(int fps);
 
+  void SetState(StateType state);
+
   void ShowErrorAndExit(const std::string &error);
 
+  // ShowErrorAndExit from the main loop, for threads other than the main thread
+  void SetError(const std::string &error);
+
   void Run();
 
 private:
@@ -83,18 +91,24 @@ private:
   cv::Size _helpSize;
   // initial image
   cv::Mat _initialImage;
-  // current image
+  // current image, swapped with the render buffer to avoid a second copy
   cv::Mat _im;
   // lock for current image
   std::mutex _imMutex;
+  // mark for current image not yet taken by render loop
+  bool _fresh = false;
   // information
   int _device = 0, _width = 0, _height = 0, _fps = 0;
+  // readiness, set from the capture and loader threads, guarded by _imMutex
+  StateType _state = StateLoadingModel;
+  // error to show, guarded by _imMutex
+  std::string _error;
   // mark for re-render
   bool _touched = false;
   // delegate
   WindowDelegate *_delegate = nullptr;
 
-  void copyImage(cv::Mat &im);
+  void takeImage(cv::Mat &im);
 
   void renderTitle(cv::Mat &im);
 